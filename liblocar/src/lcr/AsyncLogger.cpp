@@ -0,0 +1,252 @@
+//------------------------------------------------------------------------------------------
+//  Class:       lcr::AsyncLogger
+//  File:        lcr/AsyncLogger.cpp
+//
+//------------------------------------------------------------------------------------------
+#include "AsyncLogger.h"
+
+// Std
+#include <ctime>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+
+namespace lcr
+{
+
+// The number of records formatted before the output buffers are written
+static const std::size_t C_S_BATCH_RECORDS = 1024;
+
+
+AsyncLogger::AsyncLogger(unsigned int level, std::size_t capacity, Overflow overflow)
+   : AsyncLogger(level, capacity, overflow, false)
+{
+   start_writer_();
+}
+
+AsyncLogger::AsyncLogger(unsigned int level, std::size_t capacity, Overflow overflow, bool merge_errors)
+   : Logger()
+   , overflow_(overflow)
+   , merge_errors_(merge_errors)
+   , ring_()
+   , mask_()
+   , head_()
+   , tail_()
+   , timestamp_()
+   , dropped_()
+   , written_()
+   , stop_()
+   , writer_()
+{
+   level_ = level;
+   std::size_t size = 2;
+   while(size<capacity) {
+      size <<= 1;
+   }
+   ring_.reset(new Record[size]);
+   mask_ = size - 1;
+   for(std::size_t ii=0; ii<size; ++ii) {
+      ring_[ii].sequence.store(ii, std::memory_order_relaxed);
+   }
+}
+
+AsyncLogger::~AsyncLogger()
+{
+   stop_writer_();
+}
+
+
+void AsyncLogger::start_writer_()
+{
+   writer_ = std::thread(&AsyncLogger::run_, this);
+}
+
+void AsyncLogger::stop_writer_()
+{
+   if(writer_.joinable()) {
+      stop_ = true;
+      writer_.join();
+   }
+}
+
+
+void AsyncLogger::trace(unsigned int level, const char * file, unsigned int line, const char * fmt, ...)
+{
+   if(level<=level_) {
+      va_list args;
+      va_start(args, fmt);
+      push_(false, level, file, line, fmt, args);
+      va_end(args);
+   }
+}
+
+void AsyncLogger::error(unsigned int level, const char * file, unsigned int line, const char * fmt, ...)
+{
+   va_list args;
+   va_start(args, fmt);
+   push_(true, level, file, line, fmt, args);
+   va_end(args);
+}
+
+
+void AsyncLogger::flush()
+{
+   std::size_t target = head_.load(std::memory_order_acquire);
+   while(tail_.load(std::memory_order_acquire)<target && writer_.joinable()) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+   }
+}
+
+
+void AsyncLogger::push_(bool error, unsigned int level, const char * file, unsigned int line, const char * fmt, va_list args)
+{
+   // Claim a free record: the producers compete for the head position
+   Record * record;
+   std::size_t position = head_.load(std::memory_order_relaxed);
+   while(true) {
+      record = &ring_[position & mask_];
+      std::size_t sequence = record->sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+      if(difference==0) {
+         if(head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+            break;
+         }
+      }
+      else if(difference<0) { // Full: the record has not been written yet
+         if(overflow_==Overflow::drop) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+         }
+         std::this_thread::yield();
+         position = head_.load(std::memory_order_relaxed);
+      }
+      else { // Another producer has claimed it
+         position = head_.load(std::memory_order_relaxed);
+      }
+   }
+
+   // Fill it and publish it
+   record->time = std::chrono::system_clock::now();
+   record->file = file;
+   record->line = line;
+   record->level = static_cast<unsigned short>(level);
+   record->error = error;
+   int length = vsnprintf(record->text, sizeof(record->text), fmt, args);
+   if(length<0) {
+      length = 0;
+   }
+   else if(static_cast<std::size_t>(length)>=sizeof(record->text)) { // Truncated
+      length = sizeof(record->text) - 1;
+      std::memcpy(record->text + length - 3, "...", 3);
+   }
+   record->length = static_cast<unsigned short>(length);
+   record->sequence.store(position + 1, std::memory_order_release);
+}
+
+
+void AsyncLogger::run_()
+{
+   std::string out, err;
+   out.reserve(C_S_BATCH_RECORDS * 128);
+   err.reserve(C_S_BATCH_RECORDS * 16);
+   unsigned long long reported = 0;
+   unsigned int idle = 0;
+   while(true) {
+      std::size_t records = drain_(out, err);
+      // Report the dropped records, once per batch
+      unsigned long long dropped = dropped_.load(std::memory_order_relaxed);
+      if(dropped!=reported) {
+         std::size_t start = err.size();
+         header_(err, std::chrono::system_clock::now());
+         err += " WARNING: [LOGGER] " + std::to_string(dropped - reported) + " records dropped: the ring is full\n";
+         if(merge_errors_) {
+            out.append(err, start, std::string::npos);
+         }
+         reported = dropped;
+      }
+      output_(out, err);
+      if(records) {
+         idle = 0;
+         continue;
+      }
+      if(stop_ && tail_.load(std::memory_order_relaxed)==head_.load(std::memory_order_acquire)) {
+         break;
+      }
+      // Nothing to write: the producers do not wake us up (that would take a lock), so poll with a growing pause
+      std::this_thread::sleep_for(std::chrono::microseconds(idle<10 ? 50 : 1000));
+      ++idle;
+   }
+}
+
+
+std::size_t AsyncLogger::drain_(std::string& out, std::string& err)
+{
+   static const char * const C_S_ERRORS[] = { " ERROR: ", " CRITICAL: ", " ERROR: ", " WARNING: " };
+   std::size_t position = tail_.load(std::memory_order_relaxed), records = 0;
+   for(; records<C_S_BATCH_RECORDS; ++records, ++position) {
+      Record& record = ring_[position & mask_];
+      if(record.sequence.load(std::memory_order_acquire)!=position + 1) {
+         break; // Empty, or the next record is still being filled
+      }
+      std::string& buffer = (record.error && !merge_errors_) ? err : out;
+      std::size_t start = buffer.size();
+      header_(buffer, record.time);
+      if(record.error) {
+         buffer += C_S_ERRORS[record.level<=3 ? record.level : 0];
+      }
+      else {
+         buffer += " T";
+         buffer += static_cast<char>('0' + record.level % 10);
+         buffer += ": ";
+      }
+      buffer.append(record.text, record.length);
+      buffer += "  [";
+      buffer += record.file;
+      buffer += " +";
+      buffer += std::to_string(record.line);
+      buffer += "]\n";
+      if(record.error && merge_errors_) {
+         err.append(buffer, start, std::string::npos);
+      }
+      record.sequence.store(position + mask_ + 1, std::memory_order_release); // Free for the next lap
+   }
+   tail_.store(position, std::memory_order_release);
+   written_.fetch_add(records, std::memory_order_relaxed);
+   return records;
+}
+
+
+void AsyncLogger::header_(std::string& buffer, std::chrono::system_clock::time_point time)
+{
+   char text[Timestamp::C_S_SIZE];
+   buffer += "- ";
+   buffer.append(text, timestamp_.format(time, text));
+}
+
+
+void AsyncLogger::output_(std::string& out, std::string& err)
+{
+   write_(STDERR_FILENO, err);
+   write_(STDOUT_FILENO, out);
+}
+
+
+void AsyncLogger::write_(int fd, std::string& buffer)
+{
+   std::size_t written = 0;
+   while(written<buffer.size()) {
+      ssize_t bytes = ::write(fd, buffer.data() + written, buffer.size() - written);
+      if(bytes<=0) {
+         if(bytes==-1 && errno==EINTR) {
+            continue;
+         }
+         break; // Nowhere to report it
+      }
+      written += bytes;
+   }
+   buffer.clear();
+}
+
+} // namespace lcr
@@ -0,0 +1,153 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::AsyncLogger
+//  File:        lcr/AsyncLogger.h
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_AsyncLogger__H_
+#define LIB__lcr_AsyncLogger__H_
+
+// Stl
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <cstdarg>
+
+// Componentes
+#include "Logger.h"
+#include "Timestamp.hpp"
+
+
+namespace lcr
+{
+
+// This class implements a logger that does not write in the calling thread. The callers format their message into a
+// record of a bounded ring shared by all the threads (multiple producers, single consumer, lock free), and a background
+// thread adds the timestamp and the headers to the records and writes them in large batches, traces to the standard
+// output and errors to the standard error, as the StdLogger does. When the ring is full, the record is dropped and
+// counted, or the caller waits for a free record, depending on the overflow policy.
+class AsyncLogger : public Logger
+{
+   public:
+      // What to do with a record when the ring is full
+      enum class Overflow { drop, block };
+
+   public:
+      // The constructor receives as parameters the logger level, the number of records of the ring (rounded up to a
+      // power of two) and the overflow policy
+      AsyncLogger(unsigned int level = 3, std::size_t capacity = C_S_DEFAULT_CAPACITY, Overflow overflow = Overflow::drop);
+      // Destroyer: writes the pending records and stops the background thread
+      virtual ~AsyncLogger();
+
+   public:
+      // Method to write traces in the log
+      void trace(unsigned int level, const char * file, unsigned int line, const char * fmt, ...);
+      // Method to write errors in the log
+      void error(unsigned int level, const char * file, unsigned int line, const char * fmt, ...);
+
+      // Method that waits until all the records queued so far have been written
+      void flush();
+
+   public:
+      // Getter method that returns the number of records dropped because the ring was full
+      unsigned long long dropped() const override {
+         return dropped_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of records of the ring waiting to be written
+      std::size_t queued() const override {
+         std::size_t tail = tail_.load(std::memory_order_relaxed);
+         return head_.load(std::memory_order_relaxed) - tail;
+      }
+
+      // Getter method that returns the number of records written
+      unsigned long long written() const {
+         return written_.load(std::memory_order_relaxed);
+      }
+
+   public:
+      // The default number of records of the ring
+      static constexpr std::size_t C_S_DEFAULT_CAPACITY = 4096;
+      // The maximum length of a message: longer ones are truncated
+      static constexpr std::size_t C_S_TEXT_SIZE = 464;
+
+   protected:
+      // Constructor for the derived loggers, which start the background thread once they are constructed. When the
+      // errors are merged, they are written in order with the traces (see output_).
+      AsyncLogger(unsigned int level, std::size_t capacity, Overflow overflow, bool merge_errors);
+
+      // Method that starts the background thread
+      void start_writer_();
+      // Method that writes the pending records and stops the background thread. The derived loggers call it from
+      // their destroyer, before their own members are destroyed.
+      void stop_writer_();
+
+      // Virtual method, called by the background thread, that writes a batch of lines and empties the buffers:
+      // the traces to the standard output and the errors to the standard error. When the errors are merged, 'out'
+      // has the lines of both in order and 'err' a copy of the errors.
+      virtual void output_(std::string& out, std::string& err);
+
+      // Method that writes a buffer to a file descriptor and empties it
+      static void write_(int fd, std::string& buffer);
+
+   private:
+      // Private class that represents a record of the ring. Its sequence number tells its state: equal to the
+      // position to write, the record is free; equal to the position plus one, it is ready to be written.
+      struct alignas(64) Record
+      {
+         std::atomic<std::size_t> sequence;
+         std::chrono::system_clock::time_point time;
+         const char * file;
+         unsigned int line;
+         unsigned short level;
+         bool error;
+         unsigned short length;
+         char text[C_S_TEXT_SIZE];
+      };
+
+   private:
+      // Private method that formats a message into a record of the ring
+      void push_(bool error, unsigned int level, const char * file, unsigned int line, const char * fmt, va_list args);
+      // Private method with the main loop of the background thread
+      void run_();
+      // Private method that appends the formatted records to the output buffers, returns the number of records
+      std::size_t drain_(std::string& out, std::string& err);
+      // Private method that appends the header of a line
+      void header_(std::string& buffer, std::chrono::system_clock::time_point time);
+
+   private:
+      // Copy constructor (disabled)
+      AsyncLogger(const AsyncLogger&)= delete;
+      // Assignment operator (disabled)
+      AsyncLogger& operator=(const AsyncLogger&)= delete;
+
+   private:
+      // The overflow policy, and whether the errors are written with the traces
+      Overflow overflow_;
+      bool merge_errors_;
+
+      // The ring of records
+      std::unique_ptr<Record[]> ring_;
+      std::size_t mask_;
+      // The next position to write, shared by the producers, and the next one to read, owned by the background thread.
+      // Apart, to avoid false sharing.
+      alignas(64) std::atomic<std::size_t> head_;
+      alignas(64) std::atomic<std::size_t> tail_;
+
+      // The timestamps of the records, formatted by the background thread
+      Timestamp timestamp_;
+
+      // Counters for statistics purposes
+      std::atomic<unsigned long long> dropped_;
+      std::atomic<unsigned long long> written_;
+
+      // The background thread and its stop flag
+      std::atomic<bool> stop_;
+      std::thread writer_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_AsyncLogger__H_
@@ -0,0 +1,591 @@
+//------------------------------------------------------------------------------------------
+//  Class:       lcr::BinaryLogger
+//  File:        lcr/BinaryLogger.cpp
+//
+//------------------------------------------------------------------------------------------
+#include "BinaryLogger.h"
+
+// Std
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Componentes
+#include "StdLogger.h"
+#include "Exceptions.hpp"
+
+
+namespace lcr
+{
+
+namespace binary_log
+{
+   std::vector<Piece> parse(const char * format)
+   {
+      std::vector<Piece> pieces;
+      std::string text;
+      auto flush = [&]() {
+         if(!text.empty()) {
+            pieces.push_back(Piece{Type::text, Size::normal, '\0', false, false, -1, text});
+            text.clear();
+         }
+      };
+
+      const char * p = format;
+      while(*p) {
+         if(*p!='%') {
+            text += *p++;
+            continue;
+         }
+         if(p[1]=='%') {
+            text += '%';
+            p += 2;
+            continue;
+         }
+         // Flags, width and precision
+         const char * start = p++;
+         Piece piece{Type::none, Size::normal, '\0', false, false, -1, std::string()};
+         while(*p && std::strchr("-+ #0'", *p)) {
+            ++p;
+         }
+         if(*p=='*') {
+            piece.width_argument = true;
+            ++p;
+         }
+         while(std::isdigit(static_cast<unsigned char>(*p))) {
+            ++p;
+         }
+         if(*p=='.') {
+            ++p;
+            piece.precision = 0;
+            if(*p=='*') {
+               piece.precision_argument = true;
+               ++p;
+            }
+            while(std::isdigit(static_cast<unsigned char>(*p))) {
+               piece.precision = piece.precision * 10 + (*p++ - '0');
+            }
+         }
+         piece.text.assign(start, p);
+         // Length modifier
+         if(p[0]=='h' && p[1]=='h') {
+            piece.size = Size::hh;
+            p += 2;
+         }
+         else if(p[0]=='l' && p[1]=='l') {
+            piece.size = Size::ll;
+            p += 2;
+         }
+         else if(*p && std::strchr("hljztLq", *p)) {
+            static const Size C_S_SIZES[] = { Size::h, Size::l, Size::j, Size::z, Size::t, Size::L, Size::ll };
+            piece.size = C_S_SIZES[std::strchr("hljztLq", *p) - "hljztLq"];
+            ++p;
+         }
+         // Conversion
+         switch(*p)
+         {
+            case 'd': case 'i':
+               piece.type = Type::signed_integer;
+               break;
+            case 'u': case 'o': case 'x': case 'X':
+               piece.type = Type::unsigned_integer;
+               break;
+            case 'c':
+               piece.type = Type::character;
+               break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+               piece.type = Type::floating;
+               break;
+            case 's':
+               piece.type = Type::string;
+               break;
+            case 'p':
+               piece.type = Type::pointer;
+               break;
+            case 'n':
+               piece.type = Type::none;
+               break;
+            default: // Not a conversion: kept as text, as printf would do
+               text.append(start, p);
+               continue;
+         }
+         piece.conversion = *p++;
+         flush();
+         pieces.push_back(std::move(piece));
+      }
+      flush();
+      return pieces;
+   }
+}
+
+
+// Function that returns a length aligned to the records alignment
+static inline std::size_t aligned(std::size_t length)
+{
+   return (length + binary_log::C_S_ALIGNMENT - 1) & ~(binary_log::C_S_ALIGNMENT - 1);
+}
+
+
+BinaryLogger::BinaryLogger(const std::string& path, unsigned int level, std::size_t capacity)
+   : Logger()
+   , path_(path)
+   , fd_(-1)
+   , map_(nullptr)
+   , capacity_(std::max(aligned(capacity), C_S_RECORD_SIZE * 2))
+   , end_(sizeof(binary_log::FileHeader))
+   , sites_(new std::atomic<const Site *>[C_S_SITES])
+   , registered_()
+   , mutex_()
+   , dropped_()
+   , written_()
+{
+   level_ = level;
+   for(std::size_t ii=0; ii<C_S_SITES; ++ii) {
+      sites_[ii].store(nullptr, std::memory_order_relaxed);
+   }
+   fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if(fd_==-1) {
+      throw RuntimeError("Failed to create the binary log file " + path_, errno);
+   }
+   if(::ftruncate(fd_, capacity_)==-1) {
+      int ec = errno;
+      ::close(fd_);
+      throw RuntimeError("Failed to size the binary log file " + path_, ec);
+   }
+   void * map = ::mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+   if(map==MAP_FAILED) {
+      int ec = errno;
+      ::close(fd_);
+      throw RuntimeError("Failed to map the binary log file " + path_, ec);
+   }
+   map_ = static_cast<char *>(map);
+
+   binary_log::FileHeader header{};
+   std::memcpy(header.magic, binary_log::C_S_MAGIC, sizeof(header.magic));
+   header.version = binary_log::C_S_VERSION;
+   header.header_size = sizeof(binary_log::FileHeader);
+   header.capacity = capacity_;
+   std::memcpy(map_, &header, sizeof(header));
+}
+
+BinaryLogger::~BinaryLogger()
+{
+   // Close the header and trim the file to the records written
+   std::uint64_t used = std::min<std::uint64_t>(end_.load(), capacity_);
+   binary_log::FileHeader * header = reinterpret_cast<binary_log::FileHeader *>(map_);
+   header->used = used;
+   header->dropped = dropped_.load();
+   ::munmap(map_, capacity_);
+   if(::ftruncate(fd_, used)==-1) {
+      // The file keeps its capacity: the records end at the first zero size
+   }
+   ::close(fd_);
+}
+
+
+void BinaryLogger::trace(unsigned int level, const char * file, unsigned int line, const char * fmt, ...)
+{
+   if(level<=level_) {
+      va_list args;
+      va_start(args, fmt);
+      write_(false, level, file, line, fmt, args);
+      va_end(args);
+   }
+}
+
+void BinaryLogger::error(unsigned int level, const char * file, unsigned int line, const char * fmt, ...)
+{
+   va_list args, copy;
+   va_start(args, fmt);
+   va_copy(copy, args);
+   write_(true, level, file, line, fmt, args);
+   char text[C_S_RECORD_SIZE];
+   vsnprintf(text, sizeof(text), fmt, copy);
+   va_end(copy);
+   va_end(args);
+   StdLogger::instance(0).error(level, file, line, "%s", text);
+}
+
+
+void BinaryLogger::write_(bool error, unsigned int level, const char * file, unsigned int line, const char * fmt, va_list args)
+{
+   const Site * site = site_(error, level, file, line, fmt);
+   if(!site) { // The site table is full
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+   }
+
+   // Encode the arguments after the header. A record that does not fit is truncated, and the decoder stops there.
+   char record[C_S_RECORD_SIZE];
+   std::size_t size = sizeof(binary_log::RecordHeader);
+   auto put = [&](std::uint64_t value) {
+      if(size + sizeof(value) > sizeof(record)) {
+         return false;
+      }
+      std::memcpy(record + size, &value, sizeof(value));
+      size += sizeof(value);
+      return true;
+   };
+   bool room = true;
+   for(auto it=site->pieces.begin(); room && it!=site->pieces.end(); ++it) {
+      const binary_log::Piece& piece = *it;
+      if(piece.type==binary_log::Type::text) {
+         continue;
+      }
+      int precision = piece.precision;
+      if(piece.width_argument) {
+         room = put(static_cast<std::int64_t>(va_arg(args, int)));
+      }
+      if(piece.precision_argument) {
+         precision = va_arg(args, int);
+         room = room && put(static_cast<std::int64_t>(precision));
+      }
+      if(!room) {
+         break;
+      }
+      switch(piece.type)
+      {
+         case binary_log::Type::signed_integer:
+         {
+            std::int64_t value;
+            switch(piece.size)
+            {
+               case binary_log::Size::hh: value = static_cast<signed char>(va_arg(args, int)); break;
+               case binary_log::Size::h:  value = static_cast<short>(va_arg(args, int)); break;
+               case binary_log::Size::l:  value = va_arg(args, long); break;
+               case binary_log::Size::ll: value = va_arg(args, long long); break;
+               case binary_log::Size::j:  value = va_arg(args, intmax_t); break;
+               case binary_log::Size::z:  value = va_arg(args, std::make_signed<std::size_t>::type); break;
+               case binary_log::Size::t:  value = va_arg(args, ptrdiff_t); break;
+               default:                   value = va_arg(args, int); break;
+            }
+            room = put(static_cast<std::uint64_t>(value));
+            break;
+         }
+         case binary_log::Type::unsigned_integer:
+         {
+            std::uint64_t value;
+            switch(piece.size)
+            {
+               case binary_log::Size::hh: value = static_cast<unsigned char>(va_arg(args, unsigned int)); break;
+               case binary_log::Size::h:  value = static_cast<unsigned short>(va_arg(args, unsigned int)); break;
+               case binary_log::Size::l:  value = va_arg(args, unsigned long); break;
+               case binary_log::Size::ll: value = va_arg(args, unsigned long long); break;
+               case binary_log::Size::j:  value = va_arg(args, uintmax_t); break;
+               case binary_log::Size::z:  value = va_arg(args, std::size_t); break;
+               case binary_log::Size::t:  value = va_arg(args, std::make_unsigned<ptrdiff_t>::type); break;
+               default:                   value = va_arg(args, unsigned int); break;
+            }
+            room = put(value);
+            break;
+         }
+         case binary_log::Type::character:
+            room = put(static_cast<std::uint64_t>(va_arg(args, int)));
+            break;
+         case binary_log::Type::floating:
+         {
+            double value = (piece.size==binary_log::Size::L) ? static_cast<double>(va_arg(args, long double)) : va_arg(args, double);
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            room = put(bits);
+            break;
+         }
+         case binary_log::Type::string:
+         {
+            const char * text = va_arg(args, const char *);
+            if(!text) {
+               text = "(null)";
+            }
+            // The string is read up to its precision, as printf does, so it may not be null terminated
+            std::size_t limit = C_S_STRING_SIZE;
+            if(precision>=0) {
+               limit = std::min<std::size_t>(limit, precision);
+            }
+            std::size_t length = strnlen(text, limit);
+            if(size + sizeof(std::uint64_t) >= sizeof(record)) {
+               room = false;
+               break;
+            }
+            length = std::min(length, sizeof(record) - size - sizeof(std::uint64_t));
+            put(length);
+            std::memcpy(record + size, text, length);
+            std::memset(record + size + length, 0, aligned(length) - length);
+            size += aligned(length);
+            break;
+         }
+         case binary_log::Type::pointer:
+            room = put(reinterpret_cast<std::uintptr_t>(va_arg(args, void *)));
+            break;
+         default: // %n: the argument is consumed and nothing is written
+            va_arg(args, void *);
+            break;
+      }
+   }
+
+   binary_log::RecordHeader header;
+   header.size = static_cast<std::uint32_t>(size);
+   header.site = 0;
+   header.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+   std::memcpy(record, &header, sizeof(header));
+   if(append_(record, size, site->id)) {
+      written_.fetch_add(1, std::memory_order_relaxed);
+   }
+}
+
+
+const BinaryLogger::Site * BinaryLogger::site_(bool error, unsigned int level, const char * file, unsigned int line, const char * fmt)
+{
+   // Look for it without locks: the sites are never removed, so a slot that is found holds its final site
+   std::size_t hash = ((reinterpret_cast<std::uintptr_t>(fmt) ^ line) * 0x9e3779b97f4a7c15ULL) >> 32;
+   for(std::size_t probe=0; probe<C_S_SITES; ++probe) {
+      const Site * site = sites_[(hash + probe) & (C_S_SITES - 1)].load(std::memory_order_acquire);
+      if(!site) {
+         break;
+      }
+      if(site->format==fmt && site->line==line && site->file==file) {
+         return site;
+      }
+   }
+
+   // First time: register it, unless another thread has just done it
+   std::lock_guard<std::mutex> guard(mutex_);
+   std::size_t slot = hash;
+   for(;; ++slot) {
+      const Site * site = sites_[slot & (C_S_SITES - 1)].load(std::memory_order_relaxed);
+      if(!site) {
+         break;
+      }
+      if(site->format==fmt && site->line==line && site->file==file) {
+         return site;
+      }
+   }
+   if(registered_.size()>=C_S_SITES / 2) { // Keep the probes short
+      return nullptr;
+   }
+   std::unique_ptr<Site> site(new Site{static_cast<std::uint32_t>(registered_.size() + 1), fmt, file, line, error, binary_log::parse(fmt)});
+
+   // The definition is written before the site is published, so it precedes its traces in the file. If it does not fit
+   // the file is full, and the traces will not fit either.
+   binary_log::SiteDefinition definition;
+   definition.id = site->id;
+   definition.level = static_cast<std::uint16_t>(level);
+   definition.error = error;
+   definition.line = line;
+   definition.file_length = static_cast<std::uint16_t>(std::min<std::size_t>(std::strlen(file), 0xFFFF));
+   definition.format_length = static_cast<std::uint16_t>(std::min<std::size_t>(std::strlen(fmt), 0xFFFF));
+   std::size_t size = aligned(sizeof(binary_log::RecordHeader) + sizeof(definition) + definition.file_length + definition.format_length);
+   std::vector<char> record(size, '\0');
+   binary_log::RecordHeader header{static_cast<std::uint32_t>(size), 0, 0};
+   std::memcpy(record.data(), &header, sizeof(header));
+   std::memcpy(record.data() + sizeof(header), &definition, sizeof(definition));
+   std::memcpy(record.data() + sizeof(header) + sizeof(definition), file, definition.file_length);
+   std::memcpy(record.data() + sizeof(header) + sizeof(definition) + definition.file_length, fmt, definition.format_length);
+   append_(record.data(), size, binary_log::C_S_SITE_DEFINITION);
+
+   sites_[slot & (C_S_SITES - 1)].store(site.get(), std::memory_order_release);
+   registered_.push_back(std::move(site));
+   return registered_.back().get();
+}
+
+
+bool BinaryLogger::append_(const char * record, std::size_t size, std::uint32_t site)
+{
+   std::uint64_t offset = end_.fetch_add(size, std::memory_order_relaxed);
+   if(offset + size > capacity_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+   }
+   // The site is set last: until then, the decoder sees an incomplete record
+   std::memcpy(map_ + offset, record, size);
+   reinterpret_cast<std::atomic<std::uint32_t> *>(map_ + offset + offsetof(binary_log::RecordHeader, site))->store(site, std::memory_order_release);
+   return true;
+}
+
+
+
+BinaryLogReader::BinaryLogReader(const std::string& path)
+   : data_()
+   , offset_()
+   , end_()
+   , header_()
+   , sites_()
+   , timestamp_()
+   , skipped_()
+   , error_()
+{
+   std::ifstream file(path, std::ios::binary);
+   if(!file) {
+      error_ = "Unable to open the file " + path;
+      return;
+   }
+   data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+   if(data_.size()<sizeof(header_) || std::memcmp(data_.data(), binary_log::C_S_MAGIC, sizeof(binary_log::C_S_MAGIC))) {
+      error_ = path + " is not a binary log file";
+      return;
+   }
+   std::memcpy(&header_, data_.data(), sizeof(header_));
+   if(header_.version!=binary_log::C_S_VERSION) {
+      error_ = path + " has an unsupported version (" + std::to_string(header_.version) + ")";
+      return;
+   }
+   offset_ = header_.header_size;
+   end_ = header_.used ? std::min<std::size_t>(header_.used, data_.size()) : data_.size();
+}
+
+BinaryLogReader::~BinaryLogReader()
+{
+}
+
+
+bool BinaryLogReader::next(std::string& line)
+{
+   while(!error() && offset_ + sizeof(binary_log::RecordHeader)<=end_) {
+      binary_log::RecordHeader header;
+      std::memcpy(&header, data_.data() + offset_, sizeof(header));
+      if(header.size<sizeof(header) || header.size % binary_log::C_S_ALIGNMENT || offset_ + header.size>end_) {
+         break; // The end of the records, or a record that was being written when the logger stopped
+      }
+      const char * body = data_.data() + offset_ + sizeof(header);
+      std::size_t size = header.size - sizeof(header);
+      offset_ += header.size;
+
+      if(header.site==binary_log::C_S_SITE_DEFINITION) {
+         binary_log::SiteDefinition definition;
+         if(size<sizeof(definition)) {
+            ++skipped_;
+            continue;
+         }
+         std::memcpy(&definition, body, sizeof(definition));
+         if(sizeof(definition) + definition.file_length + definition.format_length>size) {
+            ++skipped_;
+            continue;
+         }
+         Site& site = sites_[definition.id];
+         site.level = definition.level;
+         site.error = definition.error;
+         site.line = definition.line;
+         site.file.assign(body + sizeof(definition), definition.file_length);
+         site.pieces = binary_log::parse(std::string(body + sizeof(definition) + definition.file_length, definition.format_length).c_str());
+         continue;
+      }
+
+      auto it = sites_.find(header.site);
+      if(it==sites_.end()) {
+         ++skipped_;
+         continue;
+      }
+      const Site& site = it->second;
+      char text[Timestamp::C_S_SIZE];
+      std::chrono::system_clock::time_point time(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(header.time)));
+      line.assign("- ");
+      line.append(text, timestamp_.format(time, text));
+      if(site.error) {
+         line += (site.level==1 ? " CRITICAL: " : (site.level==3 ? " WARNING: " : " ERROR: "));
+      }
+      else {
+         line += " T" + std::to_string(site.level) + ": ";
+      }
+      if(!format_(site, body, size, line)) {
+         line += "...";
+      }
+      line += "  [" + site.file + " +" + std::to_string(site.line) + "]";
+      return true;
+   }
+   return false;
+}
+
+
+// Function that appends a conversion of a single argument, passing the width and the precision when they are arguments
+template <class T>
+static void append(std::string& line, const std::string& spec, const binary_log::Piece& piece, int width, int precision, T value)
+{
+   char buffer[BinaryLogger::C_S_RECORD_SIZE];
+   int length;
+   if(piece.width_argument && piece.precision_argument) {
+      length = snprintf(buffer, sizeof(buffer), spec.c_str(), width, precision, value);
+   }
+   else if(piece.width_argument) {
+      length = snprintf(buffer, sizeof(buffer), spec.c_str(), width, value);
+   }
+   else if(piece.precision_argument) {
+      length = snprintf(buffer, sizeof(buffer), spec.c_str(), precision, value);
+   }
+   else {
+      length = snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+   }
+   if(length>0) {
+      line.append(buffer, std::min<std::size_t>(length, sizeof(buffer) - 1));
+   }
+}
+
+bool BinaryLogReader::format_(const Site& site, const char * body, std::size_t size, std::string& line)
+{
+   std::size_t offset = 0;
+   auto get = [&](std::uint64_t& value) {
+      if(offset + sizeof(value) > size) {
+         return false;
+      }
+      std::memcpy(&value, body + offset, sizeof(value));
+      offset += sizeof(value);
+      return true;
+   };
+   for(const binary_log::Piece& piece : site.pieces) {
+      if(piece.type==binary_log::Type::text) {
+         line += piece.text;
+         continue;
+      }
+      std::uint64_t value = 0, width = 0, precision = 0;
+      if((piece.width_argument && !get(width)) || (piece.precision_argument && !get(precision))) {
+         return false;
+      }
+      if(piece.type!=binary_log::Type::none && !get(value)) {
+         return false; // The record was truncated
+      }
+      switch(piece.type)
+      {
+         case binary_log::Type::signed_integer:
+            append(line, piece.text + "ll" + piece.conversion, piece, int(width), int(precision), static_cast<long long>(value));
+            break;
+         case binary_log::Type::unsigned_integer:
+            append(line, piece.text + "ll" + piece.conversion, piece, int(width), int(precision), static_cast<unsigned long long>(value));
+            break;
+         case binary_log::Type::character:
+            append(line, piece.text + piece.conversion, piece, int(width), int(precision), static_cast<int>(value));
+            break;
+         case binary_log::Type::floating:
+         {
+            double number;
+            std::memcpy(&number, &value, sizeof(number));
+            append(line, piece.text + piece.conversion, piece, int(width), int(precision), number);
+            break;
+         }
+         case binary_log::Type::string:
+         {
+            if(value > size - offset) {
+               return false; // A corrupted length: the sum with the offset could wrap around
+            }
+            std::string text(body + offset, value);
+            offset = std::min<std::size_t>(size, offset + aligned(value));
+            append(line, piece.text + piece.conversion, piece, int(width), int(precision), text.c_str());
+            break;
+         }
+         case binary_log::Type::pointer:
+            append(line, piece.text + piece.conversion, piece, int(width), int(precision), reinterpret_cast<void *>(value));
+            break;
+         default:
+            break;
+      }
+   }
+   return true;
+}
+
+} // namespace lcr
@@ -0,0 +1,274 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::BinaryLogger
+//  File:        lcr/BinaryLogger.h
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_BinaryLogger__H_
+#define LIB__lcr_BinaryLogger__H_
+
+// Stl
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdarg>
+#include <unordered_map>
+
+// Componentes
+#include "Logger.h"
+#include "Timestamp.hpp"
+
+
+namespace lcr
+{
+
+// Definitions of the binary log files, shared by the logger that writes them and the reader that decodes them.
+//
+// A file is a header followed by records aligned to 8 bytes. Every record starts with its size and the identifier of
+// its trace site (the format string, its file, line and level). The first record of a site defines it, so the file
+// describes itself and can be decoded without the binary that wrote it. The arguments of a trace are stored raw in
+// 8 byte slots: integers sign or zero extended to 64 bits, floating point numbers as doubles, pointers as their
+// address and strings as their length followed by their characters.
+namespace binary_log
+{
+   // The header of a file
+   struct FileHeader
+   {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t header_size;
+      std::uint64_t capacity;    // The size of the file while it is written
+      std::uint64_t used;        // The bytes used by the records, set when the file is closed (zero if it was not)
+      std::uint64_t dropped;     // The records that did not fit, set when the file is closed
+      std::uint64_t reserved[3];
+   };
+
+   // The header of a record. A zero size means the end of the records, and a zero site a record that was not
+   // completely written.
+   struct RecordHeader
+   {
+      std::uint32_t size;
+      std::uint32_t site;
+      std::uint64_t time;        // Nanoseconds since the epoch
+   };
+
+   // The body of the record that defines a site, followed by the file name and the format string
+   struct SiteDefinition
+   {
+      std::uint32_t id;
+      std::uint16_t level;
+      std::uint16_t error;
+      std::uint32_t line;
+      std::uint16_t file_length;
+      std::uint16_t format_length;
+   };
+
+   // The type of a piece of a format string: a text or a conversion specification and the argument it consumes
+   enum class Type : unsigned char { text, signed_integer, unsigned_integer, character, floating, string, pointer, none };
+   // The length modifier of an integer conversion
+   enum class Size : unsigned char { normal, hh, h, l, ll, j, z, t, L };
+
+   // A piece of a format string. Conversions keep their specification without the length modifier and the
+   // conversion character, e.g. "%-*.3" for "%-*.3llu", and whether the width and the precision are arguments.
+   struct Piece
+   {
+      Type type;
+      Size size;
+      char conversion;
+      bool width_argument;
+      bool precision_argument;
+      int precision;             // The precision written in the specification, -1 if none
+      std::string text;
+   };
+
+   // Function that splits a format string into its pieces
+   std::vector<Piece> parse(const char * format);
+
+   // Magic number, version and alignment of the files
+   static constexpr char C_S_MAGIC[8] = { 'L', 'C', 'R', 'B', 'L', 'O', 'G', '\0' };
+   static constexpr std::uint32_t C_S_VERSION = 1;
+   static constexpr std::size_t C_S_ALIGNMENT = 8;
+   // The site identifier of the records that define a site
+   static constexpr std::uint32_t C_S_SITE_DEFINITION = 0xFFFFFFFF;
+}
+
+
+// This class implements a logger that writes binary records into a memory mapped file instead of text: a trace
+// stores the identifier of its call site, a timestamp and the raw bytes of its arguments, and the formatting is done
+// offline by a decoder (see BinaryLogReader). A trace costs a lookup of its site, a copy of its arguments and an atomic
+// increment to reserve its room in the file, with no system call and no lock. The call sites are registered the first
+// time they are seen. The file has a fixed capacity: when it is full, the records are dropped and counted. Errors are
+// also written to the standard error as text, so they are not hidden in the binary file.
+class BinaryLogger : public Logger
+{
+   public:
+      // The constructor receives as parameters the path of the file, which is replaced, the logger level and the
+      // capacity of the file, in bytes. It throws a RuntimeError if the file can not be created and mapped.
+      BinaryLogger(const std::string& path, unsigned int level = 3, std::size_t capacity = C_S_DEFAULT_CAPACITY);
+      // Destroyer: closes the file, trimmed to the records written
+      virtual ~BinaryLogger();
+
+   public:
+      // Method to write traces in the log
+      void trace(unsigned int level, const char * file, unsigned int line, const char * fmt, ...);
+      // Method to write errors in the log
+      void error(unsigned int level, const char * file, unsigned int line, const char * fmt, ...);
+
+   public:
+      // Getter method that returns the path of the file
+      const std::string& path() const {
+         return path_;
+      }
+
+      // Getter method that returns the number of records dropped because the file was full
+      unsigned long long dropped() const override {
+         return dropped_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of records written
+      unsigned long long written() const {
+         return written_.load(std::memory_order_relaxed);
+      }
+
+   public:
+      // The default capacity of the file. It is created sparse, so only the pages written take disk space.
+      static constexpr std::size_t C_S_DEFAULT_CAPACITY = 256 * 1024 * 1024;
+      // The maximum size of a record, and of a string argument: longer ones are truncated
+      static constexpr std::size_t C_S_RECORD_SIZE = 2048;
+      static constexpr std::size_t C_S_STRING_SIZE = 512;
+
+   private:
+      // Private class that represents a call site, immutable once registered
+      struct Site
+      {
+         std::uint32_t id;
+         const char * format;
+         const char * file;
+         unsigned int line;
+         bool error;
+         std::vector<binary_log::Piece> pieces;
+      };
+
+   private:
+      // Private method that encodes a record and copies it into the file
+      void write_(bool error, unsigned int level, const char * file, unsigned int line, const char * fmt, va_list args);
+      // Private method that returns the site of a call, registering it the first time
+      const Site * site_(bool error, unsigned int level, const char * file, unsigned int line, const char * fmt);
+      // Private method that reserves room in the file and copies a record, returns false if it does not fit
+      bool append_(const char * record, std::size_t size, std::uint32_t site);
+
+   private:
+      // Copy constructor (disabled)
+      BinaryLogger(const BinaryLogger&)= delete;
+      // Assignment operator (disabled)
+      BinaryLogger& operator=(const BinaryLogger&)= delete;
+
+   private:
+      // The number of slots of the site table
+      static constexpr std::size_t C_S_SITES = 4096;
+
+      // The file and its mapping
+      std::string path_;
+      int fd_;
+      char * map_;
+      std::size_t capacity_;
+
+      // The offset of the next record: producers reserve their room by increasing it
+      alignas(64) std::atomic<std::uint64_t> end_;
+
+      // The site table: an open addressing hash table of the call sites, read without locks. The sites are added
+      // under the lock and never removed.
+      std::unique_ptr<std::atomic<const Site *>[]> sites_;
+      std::vector<std::unique_ptr<Site>> registered_;
+      std::mutex mutex_;
+
+      // Counters for statistics purposes
+      std::atomic<unsigned long long> dropped_;
+      std::atomic<unsigned long long> written_;
+};
+
+
+// This class decodes a binary log file into the text lines the StdLogger would have written
+class BinaryLogReader
+{
+   public:
+      // The constructor receives as parameter the path of the file
+      BinaryLogReader(const std::string& path);
+      virtual ~BinaryLogReader();
+
+   public:
+      // Public method that decodes the next trace into a line (without end of line), returns false at the end of the
+      // records. The records that are incomplete or belong to unknown sites are counted and skipped.
+      bool next(std::string& line);
+
+   public:
+      // Getter method that returns true if the file could not be read or is not a binary log
+      bool error() const {
+         return !error_.empty();
+      }
+
+      // Getter method that returns the description of the error
+      const std::string& message() const {
+         return error_;
+      }
+
+      // Getter method that returns the number of records dropped by the logger because the file was full
+      unsigned long long dropped() const {
+         return header_.dropped;
+      }
+
+      // Getter method that returns the number of records that could not be decoded
+      unsigned long long skipped() const {
+         return skipped_;
+      }
+
+      // Getter method that returns true if the file was not closed by the logger (e.g. the process crashed)
+      bool unclosed() const {
+         return !header_.used;
+      }
+
+   private:
+      // Private class that represents a decoded site
+      struct Site
+      {
+         unsigned int level;
+         bool error;
+         unsigned int line;
+         std::string file;
+         std::vector<binary_log::Piece> pieces;
+      };
+
+   private:
+      // Private method that formats the arguments of a trace after its header, returns false if they are corrupted
+      bool format_(const Site& site, const char * body, std::size_t size, std::string& line);
+
+   private:
+      // Copy constructor (disabled)
+      BinaryLogReader(const BinaryLogReader&)= delete;
+      // Assignment operator (disabled)
+      BinaryLogReader& operator=(const BinaryLogReader&)= delete;
+
+   private:
+      // The contents of the file and the offset of the next record
+      std::string data_;
+      std::size_t offset_;
+      std::size_t end_;
+      binary_log::FileHeader header_;
+
+      // The sites defined so far
+      std::unordered_map<std::uint32_t, Site> sites_;
+
+      // The timestamps are formatted in local time, as the text loggers do
+      Timestamp timestamp_;
+
+      // Counter for statistics purposes, and the error description
+      unsigned long long skipped_;
+      std::string error_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_BinaryLogger__H_
@@ -0,0 +1,143 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::BloomFilter
+//  File:        lcr/BloomFilter.hpp
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_BloomFilter__HPP_
+#define LIB__lcr_BloomFilter__HPP_
+
+
+// Stl
+#include <atomic>
+#include <memory>
+#include <cmath>
+#include <functional>
+
+
+namespace lcr
+{
+
+// This template class represents a counting Bloom filter: a compact probabilistic set that answers
+// "definitely not present" or "maybe present". Lookups are lock-free and may run concurrently with
+// modifications; modifications (insert, remove and clear) must be serialized by the owner.
+// Counters saturate at their maximum value and stay there, so deletions never produce false negatives.
+template <class KEY, class HASH = std::hash<KEY>>
+class BloomFilter
+{
+   public:
+      // The constructor receives as parameter the expected number of elements.
+      // The filter is sized with about 10 counters per element (rounded up to a power of two),
+      // which gives a false positive rate close to 1% with the 4 probes used.
+      explicit BloomFilter(std::size_t elements)
+         : mask_(size_for_(elements) - 1)
+         , counters_(new std::atomic<unsigned char>[mask_ + 1])
+         , elements_()
+      {
+         clear();
+      }
+
+      // Destroyer
+      virtual ~BloomFilter()
+      {}
+
+   public:
+      // Public method that checks if the key may be in the set: false means that it is definitely not
+      bool contains(const KEY& key) const {
+         std::size_t h1, h2;
+         hash_(key, h1, h2);
+         for(unsigned int ii=0; ii<C_S_PROBES; ++ii) {
+            if(!counters_[(h1 + ii * h2) & mask_].load(std::memory_order_acquire)) {
+               return false;
+            }
+         }
+         return true;
+      }
+
+      // Public method that adds the key to the set
+      void insert(const KEY& key) {
+         std::size_t h1, h2;
+         hash_(key, h1, h2);
+         for(unsigned int ii=0; ii<C_S_PROBES; ++ii) {
+            auto& counter = counters_[(h1 + ii * h2) & mask_];
+            unsigned char value = counter.load(std::memory_order_relaxed);
+            while(value!=C_S_SATURATED && !counter.compare_exchange_weak(value, value + 1, std::memory_order_release, std::memory_order_relaxed));
+         }
+         elements_.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      // Public method that removes the key from the set: the key must have been previously inserted
+      void remove(const KEY& key) {
+         std::size_t h1, h2;
+         hash_(key, h1, h2);
+         for(unsigned int ii=0; ii<C_S_PROBES; ++ii) {
+            auto& counter = counters_[(h1 + ii * h2) & mask_];
+            unsigned char value = counter.load(std::memory_order_relaxed);
+            while(value!=C_S_SATURATED && value && !counter.compare_exchange_weak(value, value - 1, std::memory_order_release, std::memory_order_relaxed));
+         }
+         elements_.fetch_sub(1, std::memory_order_relaxed);
+      }
+
+      // Public method that empties the set
+      void clear() {
+         for(std::size_t ii=0; ii<=mask_; ++ii) {
+            counters_[ii].store(0, std::memory_order_relaxed);
+         }
+         elements_.store(0, std::memory_order_release);
+      }
+
+   public:
+      // Getter method that returns the memory used by the counters, in bytes
+      std::size_t memoryUsage() const {
+         return (mask_ + 1) * sizeof(counters_[0]);
+      }
+
+      // Getter method that returns the theoretical false positive rate for the current number of elements
+      double falsePositiveRate() const {
+         double n = static_cast<double>(elements_.load(std::memory_order_relaxed));
+         double m = static_cast<double>(mask_ + 1);
+         return std::pow(1.0 - std::exp(-(C_S_PROBES * n) / m), C_S_PROBES);
+      }
+
+   private:
+      // Private method that derives the two hashes used for the double hashing probe sequence
+      static void hash_(const KEY& key, std::size_t& h1, std::size_t& h2) {
+         std::size_t h = HASH()(key);
+         h1 = h;
+         h2 = ((h >> 32) | (h << 32)) | 1; // odd, so the probes never collapse into the same counter
+      }
+
+      // Private method that calculates the number of counters for the expected number of elements
+      static std::size_t size_for_(std::size_t elements) {
+         std::size_t size = 64;
+         while(size < elements * 10) {
+            size <<= 1;
+         }
+         return size;
+      }
+
+   private:
+      // Copy constructor (disabled)
+      BloomFilter(const BloomFilter&) = delete;
+      // Assignment operator (disabled)
+      BloomFilter& operator=(const BloomFilter&) = delete;
+
+   private:
+      // The number of probes per key
+      static constexpr unsigned int C_S_PROBES = 4;
+      // The sticky value of a saturated counter
+      static constexpr unsigned char C_S_SATURATED = 0xff;
+
+      // The mask that maps a hash on the counters array
+      std::size_t mask_;
+
+      // The counters array
+      std::unique_ptr<std::atomic<unsigned char>[]> counters_;
+
+      // The current number of elements in the set
+      std::atomic<std::size_t> elements_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_BloomFilter__HPP_
@@ -10,13 +10,20 @@
 
 // Stl
 #include <mutex>
+#include <atomic>
 #include <chrono>
 #include <unordered_map>
+#include <memory_resource>
+#include <vector>
+#include <tuple>
 #include <sstream>
 
 // lib locar
 #include "Logger.h"
 #include "Exceptions.hpp"
+#include "BloomFilter.hpp"
+#include "NearCache.hpp"
+#include "LockProfiler.hpp"
 
 
 namespace lcr
@@ -28,24 +35,32 @@ class Cache
 {
    public:
       // The constructor receives as parameters the cache capacity and the automatic discard timeout.
-      // It also receives a reference to the logger to show traces of its operation.
-      Cache(unsigned int capacity, unsigned long long timeout, Logger& logger)
+      // It also receives a reference to the logger to show traces of its operation, and optionally the memory resource
+      // for the entries: map nodes, and keys and data when their types are allocator aware (e.g. std::pmr::string).
+      // The resource is only used while holding the cache lock, so it does not need to be thread safe.
+      Cache(unsigned int capacity, unsigned long long timeout, Logger& logger, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
          : logger_(logger)
          , capacity_(capacity)
          , timeout_(timeout)
-         , map_()
+         , map_(resource)
+         , filter_(capacity)
+         , near_(capacity, std::chrono::milliseconds(C_S_NEAR_REFRESH))
+         , generation_()
          , hits_()
          , faults_()
          , erased_()
          , overwritten_()
+         , filtered_()
+         , entries_()
          , mutex_()
+         , profiles_()
       {
-         logger_.trace(LOG_LEVEL_4, "[CACHE] The cache is ready");
+         LCR_TRACE(logger_, LOG_LEVEL_4, "[CACHE] The cache is ready");
       }
 
       // Destroyer
       virtual ~Cache() {
-         logger_.trace(LOG_LEVEL_4, "[CACHE] The cache has finished");
+         LCR_TRACE(logger_, LOG_LEVEL_4, "[CACHE] The cache has finished");
       }
 
    public:
@@ -55,76 +70,171 @@ class Cache
          return map_.size();
       }
 
+      // Getter method that returns the number of entries without locking the cache: it may lag behind the map
+      std::size_t entries() const {
+         return entries_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the cache capacity
+      unsigned int capacity() const {
+         return capacity_;
+      }
+
+      // Getter method that returns the number of lookups that found their key, in the near cache or in the map
+      unsigned long long hits() const {
+         return hits_.load(std::memory_order_relaxed) + near_.hits();
+      }
+
+      // Getter method that returns the number of lookups that did not find their key, in the filter or in the map
+      unsigned long long faults() const {
+         return faults_.load(std::memory_order_relaxed) + filtered_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of entries erased: evicted, expired or cleared
+      unsigned long long erased() const {
+         return erased_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of entries overwritten
+      unsigned long long overwritten() const {
+         return overwritten_.load(std::memory_order_relaxed);
+      }
+
       // Public method that prints the cache content
       void printContent() const {
-         logger_.trace(LOG_LEVEL_1, "[CACHE]---- Cache content ---------------------------------------------------------");
-         std::lock_guard<std::mutex> guard(mutex_);
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE]---- Cache content ---------------------------------------------------------");
+         ProfiledLock guard(mutex_, profiles_.printContent);
          if(!map_.empty()) {
             for(auto&& pair : map_) {
-               logger_.trace(LOG_LEVEL_1, "[CACHE] {key: '%s', data: %s}", to_string(pair.first).c_str(), to_string(pair.second.data_).c_str());
+               LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE] {key: '%s', data: %s}", to_string(pair.first).c_str(), to_string(pair.second.data_).c_str());
             }
-            logger_.trace(LOG_LEVEL_1, "[CACHE]----------------------------------------------------------------------------");
+            LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE]----------------------------------------------------------------------------");
          }
-         logger_.trace(LOG_LEVEL_1, "[CACHE] Total: %u entries.", map_.size());
-         logger_.trace(LOG_LEVEL_1, "[CACHE]----------------------------------------------------------------------------");
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE] Total: %u entries.", map_.size());
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE]----------------------------------------------------------------------------");
       }
 
    public:
       // Public setter method that stores in the map a new key and its related data, both passed as parameters
       void set(const KEY& key, const DATA& data) {
-         std::lock_guard<std::mutex> guard(mutex_);
-         if(capacity_>0) { // Write in cache
-            auto it = map_.find(key);
-            if(it==map_.end()) { // Insert data in the map
-               if(map_.size()==capacity_) {// delete oldest
-                  auto older_it = map_.begin();
-                  for(auto it=map_.begin(); it!=map_.end(); ++it) {
-                     if(it->second.last() < older_it->second.last()) {
-                        older_it = it;
-                     }
-                  }
-                  logger_.trace(LOG_LEVEL_4, "[CACHE] Erasing the least used entry: key '%s' => data '%s'", to_string(older_it->first).c_str(), to_string(older_it->second.data_).c_str());
-                  map_.erase(older_it);
-                  ++erased_;
-               }
-               logger_.trace(LOG_LEVEL_4, "[CACHE] Inserting new entry: key '%s' => data '%s'", to_string(key).c_str(), to_string(data).c_str());
-               auto iit = map_.insert(std::pair<KEY, Entry>(key, Entry(data))).first;
-            }
-            else { // Overwrite data in the map
-               it->second = Entry(data);
-               ++overwritten_;
-            }
+         ProfiledLock guard(mutex_, profiles_.set);
+         set_(key, data);
+      }
+
+      // Public setter method that stores a batch of keys and their related data under a single lock acquisition
+      void setMany(const std::vector<KEY>& keys, const std::vector<DATA>& data) {
+         ProfiledLock guard(mutex_, profiles_.setMany);
+         for(std::size_t ii=0; ii<keys.size() && ii<data.size(); ++ii) {
+            set_(keys[ii], data[ii]);
          }
       }
 
       // Public getter method that finds the data associated with the key passed as a parameter 
       bool get(const KEY& key, DATA& data) const {
-         std::lock_guard<std::mutex> guard(mutex_);
+         if(near_.get(key, generation_.load(std::memory_order_acquire), data)) { // Near cache hit: the shared cache is not touched
+            return true;
+         }
+         if(!filter_.contains(key)) { // Definite miss: no need to lock and probe the map
+            filtered_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+         }
+         ProfiledLock guard(mutex_, profiles_.get);
          auto it = map_.find(key);
          if(it==map_.end()) {
-            ++faults_;
+            faults_.fetch_add(1, std::memory_order_relaxed);
             return false;
          }
-         ++hits_;
+         hits_.fetch_add(1, std::memory_order_relaxed);
          data = it->second.data();
+         // The copy is made under the lock, so an overwrite or an eviction, which drop the copies of their key, can not
+         // be followed by a copy of the old data. The generation only changes under the lock too
+         near_.set(key, data, generation_.load(std::memory_order_relaxed));
          return true;
       }
 
+      // Public getter method that finds the data associated with each key of the batch passed as parameter.
+      // Near cache and filter lookups are done first, then the remaining keys are resolved under a single lock acquisition:
+      // their buckets are located and prefetched in a first pass, so the memory accesses overlap instead of being serialized,
+      // and searched in a second one, so every key is hashed once.
+      // On return, found[i] tells if data[i] has been filled. The method returns the number of keys found.
+      std::size_t getMany(const std::vector<KEY>& keys, std::vector<DATA>& data, std::vector<bool>& found) const {
+         data.resize(keys.size());
+         found.assign(keys.size(), false);
+         std::size_t total = 0;
+         std::vector<std::size_t> pending;
+         pending.reserve(keys.size());
+         unsigned long long generation = generation_.load(std::memory_order_acquire);
+         for(std::size_t ii=0; ii<keys.size(); ++ii) {
+            if(near_.get(keys[ii], generation, data[ii])) {
+               found[ii] = true;
+               ++total;
+            }
+            else if(filter_.contains(keys[ii])) {
+               pending.push_back(ii);
+            }
+            else {
+               filtered_.fetch_add(1, std::memory_order_relaxed);
+            }
+         }
+         if(pending.empty()) {
+            return total;
+         }
+         std::size_t shared = 0;
+         std::vector<std::size_t> buckets(pending.size());
+         {
+            ProfiledLock guard(mutex_, profiles_.getMany);
+            for(std::size_t jj=0; jj<pending.size(); ++jj) {
+               buckets[jj] = map_.bucket(keys[pending[jj]]);
+               auto it = map_.begin(buckets[jj]);
+               if(it!=map_.end(buckets[jj])) {
+                  __builtin_prefetch(&*it);
+               }
+            }
+            for(std::size_t jj=0; jj<pending.size(); ++jj) { // The map is not changed under the lock: the buckets stay valid
+               auto ii = pending[jj];
+               auto it = map_.begin(buckets[jj]);
+               while(it!=map_.end(buckets[jj]) && !map_.key_eq()(it->first, keys[ii])) {
+                  ++it;
+               }
+               if(it==map_.end(buckets[jj])) {
+                  faults_.fetch_add(1, std::memory_order_relaxed);
+               }
+               else {
+                  hits_.fetch_add(1, std::memory_order_relaxed);
+                  data[ii] = it->second.data();
+                  found[ii] = true;
+                  pending[shared++] = ii;
+               }
+            }
+            generation = generation_.load(std::memory_order_relaxed);
+            for(std::size_t jj=0; jj<shared; ++jj) { // Under the lock, as in get()
+               near_.set(keys[pending[jj]], data[pending[jj]], generation);
+            }
+         }
+         return total + shared;
+      }
+
       // Public method that updates the internal map of entries: required when discard functionality is active 
       void update() {
-         std::lock_guard<std::mutex> guard(mutex_);
+         ProfiledLock guard(mutex_, profiles_.update);
          if(timeout_.count()) {
+            auto erased = erased_.load(std::memory_order_relaxed);
             auto now = std::chrono::system_clock::now();
             for(auto it=map_.begin(); it!=map_.end(); ) {
                auto current = it++;
                const auto& last = current->second.last();
                std::chrono::time_point<std::chrono::system_clock> limit = last + timeout_;
                if(now>limit) {
-                  logger_.trace(LOG_LEVEL_4, "[CACHE] Erasing the oldest entry: key '%s' => data '%s'", to_string(current->first).c_str(), to_string(current->second.data_).c_str());
+                  LCR_TRACE(logger_, LOG_LEVEL_4, "[CACHE] Erasing the oldest entry: key '%s' => data '%s'", to_string(current->first).c_str(), to_string(current->second.data_).c_str());
+                  filter_.remove(current->first);
                   map_.erase(current);
-                  ++erased_;
+                  erased_.fetch_add(1, std::memory_order_relaxed);
                }
             }
+            if(erased_.load(std::memory_order_relaxed)!=erased) {
+               entries_.store(map_.size(), std::memory_order_relaxed);
+               generation_.fetch_add(1, std::memory_order_release);
+            }
          }
       }
 
@@ -132,22 +242,43 @@ class Cache
       void setTimeout(unsigned long long timeout) {
          std::lock_guard<std::mutex> guard(mutex_);
          timeout_ = std::chrono::seconds(timeout);
-         logger_.trace(LOG_LEVEL_1, "[CACHE] Updating the cache timeout [timeout:%d]", (int)timeout_.count());
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE] Updating the cache timeout [timeout:%d]", (int)timeout_.count());
       }
 
       // Public method to clear cache internal map with the entries data
       void clearContent() {
-         std::lock_guard<std::mutex> guard(mutex_);
-         erased_ += map_.size();
+         ProfiledLock guard(mutex_, profiles_.clearContent);
+         erased_.fetch_add(map_.size(), std::memory_order_relaxed);
          map_.clear();
+         entries_.store(0, std::memory_order_relaxed);
+         filter_.clear();
+         generation_.fetch_add(1, std::memory_order_release);
       }
 
       // Public method to print the cache statisctics
       void printStatistics() const {
          std::lock_guard<std::mutex> guard(mutex_);
-         logger_.trace(LOG_LEVEL_1, "[CACHE]---- Cache statistics ------------------------------------------------------");
-         logger_.trace(LOG_LEVEL_1, "[CACHE] Total: %u entries [hits:%llu] [faults:%llu] [erased:%llu] [overwritten:%llu]", map_.size(), hits_, faults_, erased_, overwritten_);
-         logger_.trace(LOG_LEVEL_1, "[CACHE]----------------------------------------------------------------------------");
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE]---- Cache statistics ------------------------------------------------------");
+         unsigned long long filtered = filtered_.load(std::memory_order_relaxed);
+         unsigned long long faults = faults_.load(std::memory_order_relaxed);
+         unsigned long long near_hits = near_.hits();
+         unsigned long long near_misses = near_.misses();
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE] Total: %u entries [hits:%llu] [faults:%llu] [erased:%llu] [overwritten:%llu]", map_.size(),
+            hits_.load(std::memory_order_relaxed) + near_hits, faults + filtered, erased_.load(std::memory_order_relaxed), overwritten_.load(std::memory_order_relaxed));
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE] Near cache: %zu shards x %zu entries [hits:%llu] [misses:%llu] [hit ratio:%.4f]",
+            near_.shards(), near_.entries(), near_hits, near_misses, (near_hits + near_misses) ? static_cast<double>(near_hits) / (near_hits + near_misses) : 0.0);
+         // Every lookup that passes the filter and then misses in the map is a false positive
+         double observed = (faults + filtered) ? static_cast<double>(faults) / (faults + filtered) : 0.0;
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE] Filter: %zu bytes [skipped:%llu] [false positives:%llu] [fp rate: observed %.4f, estimated %.4f]",
+            filter_.memoryUsage(), filtered, faults, observed, filter_.falsePositiveRate());
+         profiles_.get.print(logger_, "[CACHE]", "get");
+         profiles_.getMany.print(logger_, "[CACHE]", "getMany");
+         profiles_.set.print(logger_, "[CACHE]", "set");
+         profiles_.setMany.print(logger_, "[CACHE]", "setMany");
+         profiles_.update.print(logger_, "[CACHE]", "update");
+         profiles_.clearContent.print(logger_, "[CACHE]", "clearContent");
+         profiles_.printContent.print(logger_, "[CACHE]", "printContent");
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE]----------------------------------------------------------------------------");
       }
 
       // Public method to clear the cache statisctics
@@ -156,7 +287,48 @@ class Cache
          hits_ = 0;
          faults_ = 0;
          erased_ = 0;
-         logger_.trace(LOG_LEVEL_1, "[CACHE] Cache statistics have been cleared");
+         filtered_ = 0;
+         near_.clearStatistics();
+         profiles_.get.clear();
+         profiles_.getMany.clear();
+         profiles_.set.clear();
+         profiles_.setMany.clear();
+         profiles_.update.clear();
+         profiles_.clearContent.clear();
+         profiles_.printContent.clear();
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[CACHE] Cache statistics have been cleared");
+      }
+
+   private:
+      // Private setter method that stores the key and its related data: the caller must hold the lock
+      void set_(const KEY& key, const DATA& data) {
+         if(capacity_>0) { // Write in cache
+            auto it = map_.find(key);
+            if(it==map_.end()) { // Insert data in the map
+               if(map_.size()==capacity_) {// delete oldest
+                  auto older_it = map_.begin();
+                  for(auto it=map_.begin(); it!=map_.end(); ++it) {
+                     if(it->second.last() < older_it->second.last()) {
+                        older_it = it;
+                     }
+                  }
+                  LCR_TRACE(logger_, LOG_LEVEL_4, "[CACHE] Erasing the least used entry: key '%s' => data '%s'", to_string(older_it->first).c_str(), to_string(older_it->second.data_).c_str());
+                  filter_.remove(older_it->first);
+                  near_.invalidate(older_it->first); // Only the copies of the evicted key: the other ones stay valid
+                  map_.erase(older_it);
+                  erased_.fetch_add(1, std::memory_order_relaxed);
+               }
+               LCR_TRACE(logger_, LOG_LEVEL_4, "[CACHE] Inserting new entry: key '%s' => data '%s'", to_string(key).c_str(), to_string(data).c_str());
+               filter_.insert(key);
+               map_.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(data));
+               entries_.store(map_.size(), std::memory_order_relaxed);
+            }
+            else { // Overwrite data in the map
+               it->second.reset(data);
+               overwritten_.fetch_add(1, std::memory_order_relaxed);
+               near_.invalidate(key); // Drop the near copies of the old data
+            }
+         }
       }
 
    private:
@@ -166,12 +338,21 @@ class Cache
          friend class Cache;
 
          public:
-            // The entry constructor receives as parameter the internal data
-            Entry(const DATA& data)
-               : data_(data)
+            // The allocator used by the map, which also builds the internal data when it is allocator aware
+            typedef std::pmr::polymorphic_allocator<char> allocator_type;
+
+            // The entry constructor receives as parameters the internal data and the map allocator
+            Entry(const DATA& data, const allocator_type& allocator)
+               : data_(make_data_(data, allocator))
                , last_(std::chrono::system_clock::now())
             {}
 
+            // Method that replaces the internal data, keeping its allocator
+            void reset(const DATA& data) {
+               data_ = data;
+               last_ = std::chrono::system_clock::now();
+            }
+
             // Getter method for the entry internal data
             DATA& data() {
                last_ = std::chrono::system_clock::now();
@@ -188,6 +369,17 @@ class Cache
                return last_;
             }
 
+         private:
+            // Private method that copies the data using the allocator, only if the data type supports it
+            static DATA make_data_(const DATA& data, const allocator_type& allocator) {
+               if constexpr (std::uses_allocator<DATA, allocator_type>::value) {
+                  return DATA(data, allocator);
+               }
+               else {
+                  return DATA(data);
+               }
+            }
+
          private:
             DATA data_;  // The entry internal data
             mutable std::chrono::time_point<std::chrono::system_clock> last_;  // A point in time that marks the entry age
@@ -200,6 +392,9 @@ class Cache
       Cache& operator=(const Cache&) = delete;
 
    private:
+      // The period in milliseconds after which a near cache entry is refreshed from the map (keeps the entry access time current)
+      static constexpr unsigned int C_S_NEAR_REFRESH = 1000;
+
       // The logger reference
       Logger& logger_;
 
@@ -210,15 +405,31 @@ class Cache
       std::chrono::seconds timeout_;
 
       // The internal memory map for cache entries
-      std::unordered_map<KEY, Entry> map_;
+      std::pmr::unordered_map<KEY, Entry> map_;
 
-      // Mutable flags for statistics purposes
-      mutable unsigned long long hits_;
-      mutable unsigned long long faults_;
-      mutable unsigned long long erased_;
-      mutable unsigned long long overwritten_;
+      // The counting Bloom filter consulted before the map to skip locked lookups on definite misses
+      BloomFilter<KEY> filter_;
+
+      // The per CPU near cache consulted before the shared map, and the generation that invalidates its entries
+      mutable NearCache<KEY, DATA> near_;
+      std::atomic<unsigned long long> generation_;
+
+      // Mutable flags for statistics purposes: updated under the lock (but the filtered misses), and read without it
+      mutable std::atomic<unsigned long long> hits_;
+      mutable std::atomic<unsigned long long> faults_;
+      mutable std::atomic<unsigned long long> erased_;
+      mutable std::atomic<unsigned long long> overwritten_;
+      mutable std::atomic<unsigned long long> filtered_; // Misses resolved by the filter without locking
+      std::atomic<std::size_t> entries_;                // The size of the map, to read it without locking
 
       mutable std::mutex mutex_;
+
+      // Lock wait and hold time profiles per operation (empty unless built with LCR_LOCK_PROFILING)
+      struct LockProfiles
+      {
+         LockProfile get, getMany, set, setMany, update, clearContent, printContent;
+      };
+      mutable LockProfiles profiles_;
 };
 
 } // namespace lcr
@@ -0,0 +1,178 @@
+//------------------------------------------------------------------------------------------
+//  Class:       lcr::DigestEngine
+//  File:        lcr/DigestEngine.cpp
+//
+//------------------------------------------------------------------------------------------
+#include "DigestEngine.h"
+
+// Stl
+#include <cstring>
+#include <algorithm>
+
+// lib locar
+#include "sha.h"
+
+
+namespace
+{
+
+// MD5 in pieces
+class MD5Stream : public lcr::DigestStream
+{
+   public:
+      void update(const char * text, std::size_t length) override {
+         md5_.update(text, length);
+      }
+      lcr::DigestValue finalize() override {
+         return md5_.finalize().binarydigest();
+      }
+
+   private:
+      lcr::MD5 md5_;
+};
+
+// SHA-1 and SHA-256 in pieces
+template <lcr::SHAStream::Algorithm ALGORITHM, std::size_t SIZE>
+class SHAStream : public lcr::DigestStream
+{
+   public:
+      SHAStream() : sha_(ALGORITHM) {}
+      void update(const char * text, std::size_t length) override {
+         sha_.update(text, length);
+      }
+      lcr::DigestValue finalize() override {
+         std::uint8_t digest[SIZE];
+         sha_.finalize(digest);
+         return lcr::DigestValue(digest, SIZE);
+      }
+
+   private:
+      lcr::SHAStream sha_;
+};
+
+// MD5: the single text code, as md5_digest()
+class MD5Engine : public lcr::DigestEngine
+{
+   public:
+      lcr::DigestValue digest(const char * text, std::size_t length) const override {
+         return lcr::md5_digest(text, length);
+      }
+      std::unique_ptr<lcr::DigestStream> stream() const override {
+         return std::make_unique<MD5Stream>();
+      }
+      const char * name() const override {
+         return "md5";
+      }
+      std::size_t size() const override {
+         return 16;
+      }
+      const char * kernel() const override {
+         return "scalar";
+      }
+};
+
+// SHA-1, with the x86 SHA extensions when present
+class SHA1Engine : public lcr::DigestEngine
+{
+   public:
+      lcr::DigestValue digest(const char * text, std::size_t length) const override {
+         lcr::SHA1Digest digest = lcr::sha1_digest(text, length);
+         return lcr::DigestValue(digest.data(), digest.size());
+      }
+      std::unique_ptr<lcr::DigestStream> stream() const override {
+         return std::make_unique<SHAStream<lcr::SHAStream::Algorithm::sha1, 20>>();
+      }
+      const char * name() const override {
+         return "sha1";
+      }
+      std::size_t size() const override {
+         return 20;
+      }
+      const char * kernel() const override {
+         return lcr::sha_kernel_name(lcr::sha_kernel());
+      }
+};
+
+// SHA-256, with the x86 SHA extensions when present
+class SHA256Engine : public lcr::DigestEngine
+{
+   public:
+      lcr::DigestValue digest(const char * text, std::size_t length) const override {
+         lcr::SHA256Digest digest = lcr::sha256_digest(text, length);
+         return lcr::DigestValue(digest.data(), digest.size());
+      }
+      std::unique_ptr<lcr::DigestStream> stream() const override {
+         return std::make_unique<SHAStream<lcr::SHAStream::Algorithm::sha256, 32>>();
+      }
+      const char * name() const override {
+         return "sha256";
+      }
+      std::size_t size() const override {
+         return 32;
+      }
+      const char * kernel() const override {
+         return lcr::sha_kernel_name(lcr::sha_kernel());
+      }
+};
+
+const MD5Engine s_md5;
+const SHA1Engine s_sha1;
+const SHA256Engine s_sha256;
+const lcr::DigestEngine * const s_engines[] = { &s_md5, &s_sha1, &s_sha256 };
+
+} // namespace
+
+
+namespace lcr
+{
+
+DigestValue::DigestValue(const std::uint8_t * bytes, std::size_t size)
+   : bytes_()
+   , size_(static_cast<std::uint8_t>(std::min(size, C_S_MAX_SIZE)))
+{
+   std::memcpy(bytes_.data(), bytes, size_);
+}
+
+
+void DigestValue::hex(char * out) const
+{
+   // Whole 16 byte chunks go through the vectorized MD5 encoder, the rest (the last 4 bytes of SHA-1) through a table
+   static const char digits[] = "0123456789abcdef";
+   std::size_t ii = 0;
+   for(; ii+16<=size_; ii+=16) {
+      MD5::Digest chunk;
+      std::memcpy(chunk.data(), bytes_.data() + ii, chunk.size());
+      md5_hex(chunk, out + 2 * ii);
+   }
+   for(; ii<size_; ++ii) {
+      out[2 * ii] = digits[bytes_[ii] >> 4];
+      out[2 * ii + 1] = digits[bytes_[ii] & 0x0f];
+   }
+}
+
+
+std::ostream& operator<<(std::ostream& out, const DigestValue& digest)
+{
+   char hex[2 * DigestValue::C_S_MAX_SIZE];
+   digest.hex(hex);
+   return out.write(hex, 2 * digest.size());
+}
+
+
+const DigestEngine * DigestEngine::find(std::string_view name)
+{
+   for(const DigestEngine * engine : s_engines) {
+      if(name == engine->name()) {
+         return engine;
+      }
+   }
+   return nullptr;
+}
+
+
+const DigestEngine& DigestEngine::md5()
+{
+   return s_md5;
+}
+
+} // namespace lcr
@@ -0,0 +1,113 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::DigestEngine
+//  File:        lcr/DigestEngine.h
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_DigestEngine__H_
+#define LIB__lcr_DigestEngine__H_
+
+
+// Stl
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+// lib locar
+#include "md5.h"
+
+
+namespace lcr
+{
+
+// This class holds the binary digest of any of the engines, up to 32 bytes, inline: it can be the value of a cache
+struct DigestValue
+{
+   public:
+      // The default constructor creates an empty digest
+      DigestValue() : bytes_(), size_() {}
+
+      // The constructor receives as parameters the bytes of a digest and their number
+      DigestValue(const std::uint8_t * bytes, std::size_t size);
+
+      // Conversion from the MD5 digests
+      DigestValue(const MD5::Digest& digest) : DigestValue(digest.data(), digest.size()) {}
+
+   public:
+      // Getter method that returns the bytes of the digest
+      const std::uint8_t * data() const {
+         return bytes_.data();
+      }
+
+      // Getter method that returns the number of bytes of the digest
+      std::size_t size() const {
+         return size_;
+      }
+
+      // Public method that writes the hex representation of the digest (2 * size() chars, not null terminated)
+      void hex(char * out) const;
+
+   public:
+      // The size of the largest digest
+      static constexpr std::size_t C_S_MAX_SIZE = 32;
+
+   private:
+      std::array<std::uint8_t, C_S_MAX_SIZE> bytes_;
+      std::uint8_t size_;
+};
+
+std::ostream& operator<<(std::ostream&, const DigestValue& digest);
+
+
+// This class is the interface of a digest computed from a text given in pieces, e.g. a file read in chunks
+class DigestStream
+{
+   public:
+      virtual ~DigestStream() {}
+
+   public:
+      // Public method that adds the next piece of the text
+      virtual void update(const char * text, std::size_t length) = 0;
+
+      // Public method that returns the digest of the text, after the last piece
+      virtual DigestValue finalize() = 0;
+};
+
+
+// This class is the interface of the digest algorithms, so the server can answer any of them behind the same protocol.
+// The engines are stateless singletons, found by name.
+class DigestEngine
+{
+   public:
+      virtual ~DigestEngine() {}
+
+   public:
+      // Public method that returns the digest of a text
+      virtual DigestValue digest(const char * text, std::size_t length) const = 0;
+
+      // Public method that returns a new stream to compute a digest in pieces: the same digest as digest() of the
+      // whole text
+      virtual std::unique_ptr<DigestStream> stream() const = 0;
+
+      // Getter method that returns the name of the algorithm, as used in the requests (e.g. "sha256")
+      virtual const char * name() const = 0;
+
+      // Getter method that returns the size of the digests, in bytes
+      virtual std::size_t size() const = 0;
+
+      // Getter method that returns the name of the kernel that the engine runs (e.g. "shani" or "scalar")
+      virtual const char * kernel() const = 0;
+
+   public:
+      // Static method that returns the engine of an algorithm (md5, sha1 or sha256), or null if it is unknown
+      static const DigestEngine * find(std::string_view name);
+
+      // Static method that returns the MD5 engine, the default one
+      static const DigestEngine& md5();
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_DigestEngine__H_
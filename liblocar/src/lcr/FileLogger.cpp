@@ -0,0 +1,105 @@
+//------------------------------------------------------------------------------------------
+//  Class:       lcr::FileLogger
+//  File:        lcr/FileLogger.cpp
+//
+//------------------------------------------------------------------------------------------
+#include "FileLogger.h"
+
+// Std
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+namespace lcr
+{
+
+FileLogger::FileLogger(const std::string& path, unsigned int level, std::size_t max_size, std::chrono::seconds max_age,
+                       unsigned int files, std::size_t capacity, Overflow overflow)
+   : AsyncLogger(level, capacity, overflow, true)
+   , path_(path)
+   , max_size_(max_size)
+   , max_age_(max_age)
+   , files_(files)
+   , fd_(-1)
+   , size_()
+   , opened_()
+   , failed_()
+   , rotations_()
+{
+   if(!open_()) {
+      error(LOG_ERROR, "[LOGGER] Unable to open the log file %s: %s", path_.c_str(), strerror(errno));
+   }
+   start_writer_();
+}
+
+FileLogger::~FileLogger()
+{
+   stop_writer_();
+   if(fd_!=-1) {
+      ::close(fd_);
+   }
+}
+
+
+void FileLogger::output_(std::string& out, std::string& err)
+{
+   write_(STDERR_FILENO, err);
+   if(out.empty()) {
+      return;
+   }
+   auto now = std::chrono::steady_clock::now();
+   if(fd_!=-1 && size_ && ((max_size_ && size_ + out.size()>max_size_) || (max_age_.count() && now - opened_>=max_age_))) {
+      rotate_();
+   }
+   if(fd_==-1 && now - failed_>=std::chrono::seconds(1) && !open_()) {
+      // Not queued as an error: the background thread must not wait for room in its own ring
+      Timestamp timestamp;
+      char text[Timestamp::C_S_SIZE];
+      std::string message = "- " + std::string(text, timestamp.now(text)) + " ERROR: [LOGGER] Unable to open the log file " + path_ + ": " + strerror(errno) + "\n";
+      write_(STDERR_FILENO, message);
+   }
+   if(fd_==-1) { // The lines are lost
+      out.clear();
+      return;
+   }
+   size_ += out.size();
+   write_(fd_, out);
+}
+
+
+bool FileLogger::open_()
+{
+   fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+   if(fd_==-1) {
+      failed_ = std::chrono::steady_clock::now();
+      return false;
+   }
+   struct stat status;
+   size_ = (::fstat(fd_, &status)==0) ? status.st_size : 0;
+   opened_ = std::chrono::steady_clock::now();
+   return true;
+}
+
+
+void FileLogger::rotate_()
+{
+   ::close(fd_);
+   fd_ = -1;
+   if(files_) {
+      for(unsigned int ii=files_ - 1; ii>0; --ii) { // rename() replaces the oldest one
+         ::rename((path_ + "." + std::to_string(ii)).c_str(), (path_ + "." + std::to_string(ii + 1)).c_str());
+      }
+      ::rename(path_.c_str(), (path_ + ".1").c_str());
+   }
+   else {
+      ::unlink(path_.c_str());
+   }
+   rotations_.fetch_add(1, std::memory_order_relaxed);
+   open_();
+}
+
+} // namespace lcr
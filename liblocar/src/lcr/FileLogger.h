@@ -0,0 +1,90 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::FileLogger
+//  File:        lcr/FileLogger.h
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_FileLogger__H_
+#define LIB__lcr_FileLogger__H_
+
+// Stl
+#include <chrono>
+#include <string>
+
+// Componentes
+#include "AsyncLogger.h"
+
+
+namespace lcr
+{
+
+// This class implements a logger that writes to a file. It is an AsyncLogger: the callers only queue their records,
+// and the background thread writes them in large batches, one write per batch, with the errors in order with the
+// traces (and also on the standard error). The background thread rotates the file when it reaches a size or an age:
+// 'path' is renamed to 'path.1', 'path.1' to 'path.2' and so on, the oldest one is removed and a new 'path' is
+// created. The callers never wait for a rotation: their records stay in the ring meanwhile.
+class FileLogger : public AsyncLogger
+{
+   public:
+      // The constructor receives as parameters the path of the file, which is appended to if it exists, the logger
+      // level, the size and the age that start a new file (zero to disable them), the number of rotated files kept,
+      // the number of records of the ring and the overflow policy
+      FileLogger(const std::string& path, unsigned int level = 3, std::size_t max_size = C_S_DEFAULT_MAX_SIZE,
+                 std::chrono::seconds max_age = std::chrono::seconds(0), unsigned int files = C_S_DEFAULT_FILES,
+                 std::size_t capacity = C_S_DEFAULT_CAPACITY, Overflow overflow = Overflow::drop);
+      // Destroyer: writes the pending records and closes the file
+      virtual ~FileLogger();
+
+   public:
+      // Getter method that returns the path of the file
+      const std::string& path() const {
+         return path_;
+      }
+
+      // Getter method that returns the number of times the file has been rotated
+      unsigned long long rotations() const {
+         return rotations_.load(std::memory_order_relaxed);
+      }
+
+   public:
+      // The default size that starts a new file, and the default number of rotated files kept
+      static constexpr std::size_t C_S_DEFAULT_MAX_SIZE = 64 * 1024 * 1024;
+      static constexpr unsigned int C_S_DEFAULT_FILES = 5;
+
+   protected:
+      // Method that writes a batch of lines to the file, rotating it first if it is due
+      void output_(std::string& out, std::string& err);
+
+   private:
+      // Private method that opens the file to append to it, returns false on errors
+      bool open_();
+      // Private method that closes the file and shifts the rotated ones
+      void rotate_();
+
+   private:
+      // Copy constructor (disabled)
+      FileLogger(const FileLogger&)= delete;
+      // Assignment operator (disabled)
+      FileLogger& operator=(const FileLogger&)= delete;
+
+   private:
+      // The path and the rotation limits
+      std::string path_;
+      std::size_t max_size_;
+      std::chrono::seconds max_age_;
+      unsigned int files_;
+
+      // The current file (only used by the background thread), its size and when it was opened
+      int fd_;
+      std::size_t size_;
+      std::chrono::steady_clock::time_point opened_;
+      // When the last attempt to open the file failed, so it is retried once per second
+      std::chrono::steady_clock::time_point failed_;
+
+      // Counter for statistics purposes
+      std::atomic<unsigned long long> rotations_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_FileLogger__H_
@@ -0,0 +1,117 @@
+//------------------------------------------------------------------------------------------
+//  Class:       lcr::HashBatcher
+//  File:        lcr/HashBatcher.cpp
+//
+//------------------------------------------------------------------------------------------
+#include "HashBatcher.h"
+
+// Stl
+#include <algorithm>
+
+
+namespace lcr
+{
+
+HashBatcher::HashBatcher(std::chrono::microseconds deadline, unsigned int lanes)
+   : deadline_(deadline)
+   , lanes_(lanes ? lanes : md5_kernel_lanes(md5_kernel()))
+   , pending_()
+   , queued_()
+   , mutex_()
+   , submitted_()
+   , hashed_()
+   , stop_()
+   , batches_()
+   , requests_()
+   , bytes_()
+   , hashing_()
+   , queueing_()
+   , max_queueing_()
+   , thread_(&HashBatcher::run_, this)
+{
+}
+
+HashBatcher::~HashBatcher()
+{
+   {
+      std::lock_guard<std::mutex> guard(mutex_);
+      stop_ = true;
+   }
+   submitted_.notify_one();
+   thread_.join();
+}
+
+
+MD5::Digest HashBatcher::digest(const char * text, std::size_t length)
+{
+   Request request{std::string_view(text, length), MD5::Digest(), std::chrono::steady_clock::now(), false};
+   std::unique_lock<std::mutex> lock(mutex_);
+   pending_.push_back(&request);
+   queued_.store(pending_.size(), std::memory_order_relaxed);
+   if(pending_.size()==1 || pending_.size()==lanes_) { // The first text starts the deadline, the last one ends it
+      submitted_.notify_one();
+   }
+   hashed_.wait(lock, [&request]() { return request.done; });
+   return request.digest;
+}
+
+
+double HashBatcher::fillRate() const
+{
+   unsigned long long batches = batches_.load(std::memory_order_relaxed);
+   return batches ? static_cast<double>(requests_.load(std::memory_order_relaxed)) / (batches * lanes_) : 0.0;
+}
+
+
+void HashBatcher::run_()
+{
+   std::vector<Request *> batch;
+   std::vector<std::string_view> texts;
+   std::vector<MD5::Digest> digests;
+   std::unique_lock<std::mutex> lock(mutex_);
+   while(true) {
+      submitted_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+      if(pending_.empty()) { // Stopped
+         break;
+      }
+      // Wait for a full batch until the deadline of the oldest text
+      submitted_.wait_until(lock, pending_.front()->arrival + deadline_, [this]() { return stop_ || pending_.size()>=lanes_; });
+      std::size_t count = std::min<std::size_t>(pending_.size(), lanes_);
+      batch.assign(pending_.begin(), pending_.begin() + count);
+      pending_.erase(pending_.begin(), pending_.begin() + count);
+      queued_.store(pending_.size(), std::memory_order_relaxed);
+      lock.unlock();
+
+      // Hash the batch out of the lock, so new texts can queue meanwhile
+      auto start = std::chrono::steady_clock::now();
+      texts.resize(count);
+      digests.resize(count);
+      long long queueing = 0, max_queueing = 0;
+      unsigned long long bytes = 0;
+      for(std::size_t ii=0; ii<count; ++ii) {
+         texts[ii] = batch[ii]->text;
+         bytes += texts[ii].size();
+         long long waited = std::chrono::duration_cast<std::chrono::nanoseconds>(start - batch[ii]->arrival).count();
+         queueing += waited;
+         max_queueing = std::max(max_queueing, waited);
+      }
+      md5_many(texts.data(), digests.data(), count);
+      hashing_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+      batches_.fetch_add(1, std::memory_order_relaxed);
+      requests_.fetch_add(count, std::memory_order_relaxed);
+      bytes_.fetch_add(bytes, std::memory_order_relaxed);
+      queueing_.fetch_add(queueing, std::memory_order_relaxed);
+      if(max_queueing>max_queueing_.load(std::memory_order_relaxed)) {
+         max_queueing_.store(max_queueing, std::memory_order_relaxed); // Only the stage thread writes it
+      }
+
+      lock.lock();
+      for(std::size_t ii=0; ii<count; ++ii) {
+         batch[ii]->digest = digests[ii];
+         batch[ii]->done = true;
+      }
+      hashed_.notify_all();
+   }
+}
+
+} // namespace lcr
@@ -0,0 +1,139 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::HashBatcher
+//  File:        lcr/HashBatcher.h
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_HashBatcher__H_
+#define LIB__lcr_HashBatcher__H_
+
+
+// Stl
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string_view>
+#include <condition_variable>
+
+// lib locar
+#include "md5.h"
+
+
+namespace lcr
+{
+
+// This class is a hashing stage shared by independent threads: each thread submits a text and waits for its digest,
+// while the stage thread collects the pending texts into batches and hashes them together with md5_many, so they
+// fill the lanes of the multi-buffer kernel. A batch starts when it has as many texts as the kernel has lanes, or
+// when the deadline after its first text expires, whichever comes first.
+class HashBatcher
+{
+   public:
+      // The constructor receives as parameters the deadline of a batch and its maximum size (zero for the lanes of the bound kernel)
+      HashBatcher(std::chrono::microseconds deadline, unsigned int lanes = 0);
+      virtual ~HashBatcher();
+
+   public:
+      // Public method that returns the digest of a text, waiting for the batch that hashes it
+      MD5::Digest digest(const char * text, std::size_t length);
+
+   public:
+      // Getter method that returns the maximum size of a batch
+      unsigned int lanes() const {
+         return lanes_;
+      }
+
+      // Getter method that returns the deadline of a batch
+      std::chrono::microseconds deadline() const {
+         return deadline_;
+      }
+
+      // Getter method that returns the number of batches hashed
+      unsigned long long batches() const {
+         return batches_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of texts hashed
+      unsigned long long requests() const {
+         return requests_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of bytes hashed
+      unsigned long long bytes() const {
+         return bytes_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the time spent hashing the batches
+      std::chrono::nanoseconds hashingTime() const {
+         return std::chrono::nanoseconds(hashing_.load(std::memory_order_relaxed));
+      }
+
+      // Getter method that returns the average fill rate of the batches, from 0 to 1
+      double fillRate() const;
+
+      // Getter method that returns the total time that the texts waited for their batch to start
+      std::chrono::nanoseconds queueingTime() const {
+         return std::chrono::nanoseconds(queueing_.load(std::memory_order_relaxed));
+      }
+
+      // Getter method that returns the longest time that a text waited for its batch to start
+      std::chrono::nanoseconds maxQueueingTime() const {
+         return std::chrono::nanoseconds(max_queueing_.load(std::memory_order_relaxed));
+      }
+
+      // Getter method that returns the number of texts waiting for their batch
+      std::size_t queued() const {
+         return queued_.load(std::memory_order_relaxed);
+      }
+
+   private:
+      // Private class that represents a submitted text, which lives in the stack of the thread that waits for it
+      struct Request
+      {
+         std::string_view text;
+         MD5::Digest digest;
+         std::chrono::steady_clock::time_point arrival;
+         bool done;
+      };
+
+   private:
+      // Private method with the main loop of the stage thread
+      void run_();
+
+   private:
+      // Copy constructor (disabled)
+      HashBatcher(const HashBatcher&) = delete;
+      // Assignment operator (disabled)
+      HashBatcher& operator=(const HashBatcher&) = delete;
+
+   private:
+      // The batch limits
+      std::chrono::microseconds deadline_;
+      unsigned int lanes_;
+
+      // The pending texts, in arrival order, and their synchronization: the stage thread waits for texts and the
+      // submitting threads wait for their digests
+      std::vector<Request *> pending_;
+      std::atomic<std::size_t> queued_; // The number of pending texts, to read it without the lock
+      std::mutex mutex_;
+      std::condition_variable submitted_;
+      std::condition_variable hashed_;
+      bool stop_;
+
+      // Counters for statistics purposes
+      std::atomic<unsigned long long> batches_;
+      std::atomic<unsigned long long> requests_;
+      std::atomic<unsigned long long> bytes_;
+      std::atomic<long long> hashing_;
+      std::atomic<long long> queueing_;
+      std::atomic<long long> max_queueing_;
+
+      // The stage thread
+      std::thread thread_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_HashBatcher__H_
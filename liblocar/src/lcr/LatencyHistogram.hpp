@@ -0,0 +1,127 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::LatencyHistogram
+//  File:        lcr/LatencyHistogram.hpp
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_LatencyHistogram__HPP_
+#define LIB__lcr_LatencyHistogram__HPP_
+
+
+// Stl
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+
+namespace lcr
+{
+
+// This class implements a histogram of latencies in nanoseconds with the buckets of an HDR histogram: every power of
+// two is split in 32 linear buckets, so the values are kept with a relative error below 3.2% from 1 ns to 36 minutes
+// (larger ones go to the last bucket) in 9 kB. The counters are relaxed atomics, so the histogram can be recorded and
+// read by several threads without locks: a read that races with records may miss some of them.
+class LatencyHistogram
+{
+   public:
+      // Constructor
+      LatencyHistogram()
+         : buckets_()
+         , count_()
+         , total_()
+         , max_()
+      {}
+
+      // Destroyer
+      virtual ~LatencyHistogram()
+      {}
+
+   public:
+      // Public method that records a latency
+      void record(unsigned long long ns) {
+         buckets_[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+         count_.fetch_add(1, std::memory_order_relaxed);
+         total_.fetch_add(ns, std::memory_order_relaxed);
+         unsigned long long max = max_.load(std::memory_order_relaxed);
+         while(ns>max && !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+         }
+      }
+
+      // Public method that returns the latency under which are the given fraction of the values (e.g. 0.99): the
+      // highest value of its bucket, and never more than the maximum
+      unsigned long long percentile(double p) const {
+         unsigned long long count = count_.load(std::memory_order_relaxed);
+         unsigned long long max = max_.load(std::memory_order_relaxed);
+         unsigned long long accumulated = 0;
+         for(unsigned int ii=0; ii<C_S_BUCKETS && count; ++ii) {
+            accumulated += buckets_[ii].load(std::memory_order_relaxed);
+            if(accumulated>=p * count) {
+               return std::min(max, highest(ii));
+            }
+         }
+         return max;
+      }
+
+   public:
+      // Getter method that returns the number of latencies recorded
+      unsigned long long count() const {
+         return count_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the sum of the latencies recorded
+      unsigned long long total() const {
+         return total_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the highest latency recorded
+      unsigned long long max() const {
+         return max_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of latencies of a bucket
+      unsigned long long count(unsigned int bucket) const {
+         return buckets_[bucket].load(std::memory_order_relaxed);
+      }
+
+   public:
+      // Function that returns the bucket of a latency: the values below 64 have their own bucket, and the rest are
+      // split by their highest bit and the next 5 bits
+      static unsigned int bucket(unsigned long long ns) {
+         if(ns<2 * C_S_SUB_BUCKETS) {
+            return static_cast<unsigned int>(ns);
+         }
+         unsigned int shift = 63 - __builtin_clzll(ns) - C_S_SUB_BITS;
+         return std::min(C_S_BUCKETS - 1, shift * C_S_SUB_BUCKETS + static_cast<unsigned int>(ns >> shift));
+      }
+
+      // Function that returns the highest latency of a bucket
+      static unsigned long long highest(unsigned int bucket) {
+         if(bucket<2 * C_S_SUB_BUCKETS) {
+            return bucket;
+         }
+         unsigned int shift = bucket / C_S_SUB_BUCKETS - 1;
+         return ((static_cast<unsigned long long>(bucket - shift * C_S_SUB_BUCKETS) + 1) << shift) - 1;
+      }
+
+   public:
+      // The buckets of every power of two, and the number of buckets: up to 2^41 ns
+      static constexpr unsigned int C_S_SUB_BITS = 5;
+      static constexpr unsigned int C_S_SUB_BUCKETS = 1u << C_S_SUB_BITS;
+      static constexpr unsigned int C_S_BUCKETS = (40 - C_S_SUB_BITS + 2) * C_S_SUB_BUCKETS;
+
+   private:
+      // Copy constructor (disabled)
+      LatencyHistogram(const LatencyHistogram&) = delete;
+      // Assignment operator (disabled)
+      LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+   private:
+      std::atomic<unsigned long long> buckets_[C_S_BUCKETS];
+      std::atomic<unsigned long long> count_;
+      std::atomic<unsigned long long> total_;
+      std::atomic<unsigned long long> max_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_LatencyHistogram__HPP_
@@ -0,0 +1,192 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::LockProfile
+//  Class:       lcr::ProfiledLock
+//  File:        lcr/LockProfiler.hpp
+//
+//  Desc:        Optional lock instrumentation, enabled building with -DLCR_LOCK_PROFILING.
+//               When disabled, ProfiledLock is a plain std::lock_guard and LockProfile is empty.
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_LockProfiler__HPP_
+#define LIB__lcr_LockProfiler__HPP_
+
+
+// Stl
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <algorithm>
+
+// lib locar
+#include "Logger.h"
+
+
+namespace lcr
+{
+
+#ifdef LCR_LOCK_PROFILING
+
+// This class records the wait and hold times of a lock for one operation, as histograms with power of two buckets
+// in nanoseconds. It is only updated by the lock owner, so the lock itself protects it.
+class LockProfile
+{
+   public:
+      // Constructor
+      LockProfile()
+         : acquisitions_()
+         , contentions_()
+         , wait_()
+         , hold_()
+      {}
+
+   public:
+      // Public method that records one lock acquisition
+      void record(unsigned long long wait, unsigned long long hold, bool contended) {
+         ++acquisitions_;
+         if(contended) {
+            ++contentions_;
+         }
+         wait_.record(wait);
+         hold_.record(hold);
+      }
+
+      // Public method that prints the profile: the lock must be held by the caller
+      void print(Logger& logger, const char * owner, const char * operation) const {
+         if(!acquisitions_) {
+            return;
+         }
+         LCR_TRACE(logger, LOG_LEVEL_1, "%s Lock %-12s [acquisitions:%llu] [contended:%llu (%.2f%%)]", owner, operation,
+            acquisitions_, contentions_, 100.0 * contentions_ / acquisitions_);
+         wait_.print(logger, owner, "wait", acquisitions_);
+         hold_.print(logger, owner, "hold", acquisitions_);
+      }
+
+      // Public method that discards the recorded acquisitions: the lock must be held by the caller
+      void clear() {
+         acquisitions_ = 0;
+         contentions_ = 0;
+         wait_ = Histogram();
+         hold_ = Histogram();
+      }
+
+   private:
+      // Private class that represents a histogram of durations
+      struct Histogram
+      {
+         // Method that adds a duration in nanoseconds
+         void record(unsigned long long ns) {
+            unsigned int bucket = 0;
+            while(bucket<C_S_BUCKETS-1 && (ns >> (bucket + 1))) {
+               ++bucket;
+            }
+            ++buckets[bucket];
+            total += ns;
+            if(ns>max) {
+               max = ns;
+            }
+         }
+
+         // Method that returns the upper bound of the bucket containing the percentile
+         unsigned long long percentile(double p, unsigned long long count) const {
+            unsigned long long accumulated = 0;
+            for(unsigned int ii=0; ii<C_S_BUCKETS; ++ii) {
+               accumulated += buckets[ii];
+               if(accumulated >= p * count) {
+                  return std::min(max, (2ULL << ii) - 1);
+               }
+            }
+            return max;
+         }
+
+         // Method that prints the percentiles and the non empty buckets
+         void print(Logger& logger, const char * owner, const char * name, unsigned long long count) const {
+            LCR_TRACE(logger, LOG_LEVEL_1, "%s      %s ns: [avg:%llu] [p50:%llu] [p90:%llu] [p99:%llu] [max:%llu]", owner, name,
+               total / count, percentile(0.5, count), percentile(0.9, count), percentile(0.99, count), max);
+            std::string line;
+            for(unsigned int ii=0; ii<C_S_BUCKETS; ++ii) {
+               if(buckets[ii]) {
+                  line += " <" + std::to_string(2ULL << ii) + ":" + std::to_string(buckets[ii]);
+               }
+            }
+            LCR_TRACE(logger, LOG_LEVEL_2, "%s      %s histogram:%s", owner, name, line.c_str());
+         }
+
+         static constexpr unsigned int C_S_BUCKETS = 40;
+         unsigned long long buckets[C_S_BUCKETS] = {};
+         unsigned long long total = 0;
+         unsigned long long max = 0;
+      };
+
+   private:
+      unsigned long long acquisitions_; // Total number of acquisitions
+      unsigned long long contentions_;  // Acquisitions that found the lock already taken
+      Histogram wait_;                  // Time spent waiting for the lock
+      Histogram hold_;                  // Time spent holding the lock
+};
+
+
+// This class is a scoped lock that records its wait and hold times in a lock profile
+class ProfiledLock
+{
+   public:
+      // The constructor receives as parameters the mutex to lock and the profile of the operation
+      ProfiledLock(std::mutex& mutex, LockProfile& profile)
+         : mutex_(mutex)
+         , profile_(profile)
+         , contended_()
+      {
+         auto start = std::chrono::steady_clock::now();
+         contended_ = !mutex_.try_lock();
+         if(contended_) {
+            mutex_.lock();
+         }
+         acquired_ = std::chrono::steady_clock::now();
+         wait_ = std::chrono::duration_cast<std::chrono::nanoseconds>(acquired_ - start).count();
+      }
+
+      // Destroyer: records the profile before releasing the mutex
+      ~ProfiledLock() {
+         auto hold = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - acquired_).count();
+         profile_.record(wait_, hold, contended_);
+         mutex_.unlock();
+      }
+
+   private:
+      // Copy constructor (disabled)
+      ProfiledLock(const ProfiledLock&) = delete;
+      // Assignment operator (disabled)
+      ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+   private:
+      std::mutex& mutex_;
+      LockProfile& profile_;
+      bool contended_;
+      std::chrono::steady_clock::time_point acquired_;
+      unsigned long long wait_;
+};
+
+#else // LCR_LOCK_PROFILING
+
+// Empty lock profile: profiling is disabled
+class LockProfile
+{
+   public:
+      void print(Logger&, const char *, const char *) const {}
+      void clear() {}
+};
+
+// Plain scoped lock: profiling is disabled
+class ProfiledLock : public std::lock_guard<std::mutex>
+{
+   public:
+      ProfiledLock(std::mutex& mutex, LockProfile&)
+         : std::lock_guard<std::mutex>(mutex)
+      {}
+};
+
+#endif // LCR_LOCK_PROFILING
+
+} // namespace lcr
+
+#endif // LIB__lcr_LockProfiler__HPP_
@@ -0,0 +1,170 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::LogRateLimiter, lcr::LogSampler
+//  File:        lcr/LogLimiter.hpp
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_LogLimiter__HPP_
+#define LIB__lcr_LogLimiter__HPP_
+
+
+// Stl
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+
+// lib locar
+#include "Logger.h"
+
+
+// Front-ends for the call sites that a client can trigger at will, each one with its own limiter (a static object of
+// the call site), so a flood of messages can not degrade the server through its logger. The arguments of the messages
+// that are not written are not evaluated.
+//
+// At most 'per_second' messages of the call site are written per second. The next message written after some were
+// suppressed is preceded by a line with their number:
+//    LCR_ERROR_LIMITED(logger, 10, LOG_WARNING, "fmt", args...)
+//    LCR_TRACE_LIMITED(logger, 10, LOG_LEVEL_4, "fmt", args...)
+#define LCR_ERROR_LIMITED(logger, per_second, ...) \
+   do { \
+      static lcr::LogRateLimiter lcr_limiter_(per_second); \
+      unsigned long long lcr_suppressed_; \
+      if(lcr_limiter_.allow(lcr_suppressed_)) { \
+         if(lcr_suppressed_) { \
+            (logger).error(LCR_LOG_LEVEL_OF_(__VA_ARGS__), __FILE__, __LINE__, "[LOGGER] %llu similar messages suppressed", lcr_suppressed_); \
+         } \
+         (logger).error(__VA_ARGS__); \
+      } \
+   } while(0)
+
+#define LCR_TRACE_LIMITED(logger, per_second, ...) \
+   do { \
+      if(LCR_LOG_LEVEL_OF_(__VA_ARGS__)<=LCR_LOG_COMPILED_LEVEL && (logger).enabled(LCR_LOG_LEVEL_OF_(__VA_ARGS__))) { \
+         static lcr::LogRateLimiter lcr_limiter_(per_second); \
+         unsigned long long lcr_suppressed_; \
+         if(lcr_limiter_.allow(lcr_suppressed_)) { \
+            if(lcr_suppressed_) { \
+               (logger).trace(LCR_LOG_LEVEL_OF_(__VA_ARGS__), __FILE__, __LINE__, "[LOGGER] %llu similar messages suppressed", lcr_suppressed_); \
+            } \
+            (logger).trace(__VA_ARGS__); \
+         } \
+      } \
+   } while(0)
+
+// One message of every 'one_in' of the call site is written, chosen at random, e.g. for the traces of every request:
+//    LCR_TRACE_SAMPLED(logger, 100, LOG_LEVEL_5, "fmt", args...)
+#define LCR_TRACE_SAMPLED(logger, one_in, ...) \
+   do { \
+      if(LCR_LOG_LEVEL_OF_(__VA_ARGS__)<=LCR_LOG_COMPILED_LEVEL && (logger).enabled(LCR_LOG_LEVEL_OF_(__VA_ARGS__))) { \
+         static lcr::LogSampler lcr_sampler_(one_in); \
+         if(lcr_sampler_.allow()) { \
+            (logger).trace(__VA_ARGS__); \
+         } \
+      } \
+   } while(0)
+
+
+namespace lcr
+{
+
+// This class limits the number of messages of a call site per second, counting the ones that are not written.
+// Windows of one second are counted without locks: when several threads start a new window at the same time, a few
+// more messages than the limit may be written.
+class LogRateLimiter
+{
+   public:
+      // The constructor receives as parameter the number of messages written per second
+      explicit LogRateLimiter(unsigned int per_second)
+         : limit_(std::max(1u, per_second))
+         , window_(-1)
+         , count_()
+         , suppressed_()
+      {}
+
+      // Destroyer
+      virtual ~LogRateLimiter()
+      {}
+
+   public:
+      // Public method that returns true if a message can be written, and in that case the number of messages that were
+      // suppressed since the last one written
+      bool allow(unsigned long long& suppressed) {
+         std::int64_t second = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+         std::int64_t window = window_.load(std::memory_order_relaxed);
+         if(second!=window && window_.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+            count_.store(0, std::memory_order_relaxed);
+         }
+         if(count_.fetch_add(1, std::memory_order_relaxed)<limit_) {
+            suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+            return true;
+         }
+         suppressed_.fetch_add(1, std::memory_order_relaxed);
+         return false;
+      }
+
+   public:
+      // Getter method that returns the number of messages suppressed and not reported yet
+      unsigned long long suppressed() const {
+         return suppressed_.load(std::memory_order_relaxed);
+      }
+
+   private:
+      // Copy constructor (disabled)
+      LogRateLimiter(const LogRateLimiter&) = delete;
+      // Assignment operator (disabled)
+      LogRateLimiter& operator=(const LogRateLimiter&) = delete;
+
+   private:
+      // The limit, the current window (in seconds of the steady clock) and the messages of that window
+      unsigned int limit_;
+      std::atomic<std::int64_t> window_;
+      std::atomic<unsigned int> count_;
+
+      // The messages suppressed since the last one written
+      std::atomic<unsigned long long> suppressed_;
+};
+
+
+// This class samples the messages of a call site: each one is written with a probability of 1 / 'one_in'. The random
+// numbers come from a generator of the calling thread, so the sampler has no shared state to write: a message that is
+// not written costs a few arithmetic operations.
+class LogSampler
+{
+   public:
+      // The constructor receives as parameter the inverse of the probability of writing a message
+      explicit LogSampler(unsigned int one_in)
+         : one_in_(std::max(1u, one_in))
+      {}
+
+      // Destroyer
+      virtual ~LogSampler()
+      {}
+
+   public:
+      // Public method that returns true if a message is written
+      bool allow() const {
+         // xorshift64*, seeded per thread
+         static thread_local std::uint64_t state = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+         state ^= state >> 12;
+         state ^= state << 25;
+         state ^= state >> 27;
+         return ((state * 0x2545F4914F6CDD1DULL) >> 32) % one_in_ == 0;
+      }
+
+   private:
+      // Copy constructor (disabled)
+      LogSampler(const LogSampler&) = delete;
+      // Assignment operator (disabled)
+      LogSampler& operator=(const LogSampler&) = delete;
+
+   private:
+      // The inverse of the probability
+      unsigned int one_in_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_LogLimiter__HPP_
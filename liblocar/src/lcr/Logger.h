@@ -8,6 +8,7 @@
 #define LIB__lcr_Logger__H_
 
 // Stl
+#include <atomic>
 #include <string>
 #include <cstdarg>
 #include <vector>
@@ -25,6 +26,22 @@
 #define  LOG_ERROR    2,__FILE__,__LINE__
 #define  LOG_WARNING  3,__FILE__,__LINE__
 
+// The trace sites whose level is above this one are removed from the build (e.g. -DLCR_LOG_COMPILED_LEVEL=3 for release builds)
+#ifndef LCR_LOG_COMPILED_LEVEL
+#define LCR_LOG_COMPILED_LEVEL 6
+#endif
+
+// Front-end for the traces:  LCR_TRACE(logger, LOG_LEVEL_4, "fmt", args...)
+// The level is checked before the arguments are evaluated, so a disabled trace costs a comparison and builds no string,
+// and the trace sites above LCR_LOG_COMPILED_LEVEL compile to nothing
+#define LCR_LOG_LEVEL_OF_(level, ...) (level)
+#define LCR_TRACE(logger, ...) \
+   do { \
+      if(LCR_LOG_LEVEL_OF_(__VA_ARGS__)<=LCR_LOG_COMPILED_LEVEL && (logger).enabled(LCR_LOG_LEVEL_OF_(__VA_ARGS__))) { \
+         (logger).trace(__VA_ARGS__); \
+      } \
+   } while(0)
+
 namespace lcr
 {
 
@@ -37,9 +54,36 @@ class Logger
       // Virtual pure method to write errors in the log
       virtual void error(unsigned int level, const char * file, unsigned int line, const char * fmt, ...) = 0; // Errores
 
+   public:
+      // Method that returns true if the traces of a level are written: errors are always written
+      bool enabled(unsigned int level) const {
+         return level<=level_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the logger level
+      unsigned int level() const {
+         return level_.load(std::memory_order_relaxed);
+      }
+
+      // Setter method for the logger level
+      void level(unsigned int level) {
+         level_.store(level, std::memory_order_relaxed);
+      }
+
+      // Virtual getter method that returns the number of records lost by the logger (none, unless it overrides it)
+      virtual unsigned long long dropped() const {
+         return 0;
+      }
+
+      // Virtual getter method that returns the number of records waiting to be written (none, unless it overrides it)
+      virtual std::size_t queued() const {
+         return 0;
+      }
+
    protected:
       // Constructor
       Logger()
+         : level_(3)
       {}
 
       // Destroyer 
@@ -51,6 +95,10 @@ class Logger
       Logger(const Logger&)= delete;
       // Assignment operator (disabled)
       Logger& operator=(const Logger&)= delete;
+
+   protected:
+      // The logger current level: traces above it are discarded
+      std::atomic<unsigned int> level_;
 };
 
 } // namespace lcr
@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------------------
+//  Class:       lcr::MD5PrefixCache
+//  File:        lcr/MD5PrefixCache.cpp
+//
+//------------------------------------------------------------------------------------------
+#include "MD5PrefixCache.h"
+
+// Stl
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+
+namespace lcr
+{
+
+MD5PrefixCache::MD5PrefixCache(std::size_t memory, std::size_t max_prefix)
+   : nodes_()
+   , mutex_()
+   , max_nodes_(std::max<std::size_t>(1, memory / C_S_NODE_MEMORY))
+   , max_blocks_(max_prefix / 64)
+   , sequence_()
+   , generation_()
+   , hits_()
+   , misses_()
+   , hashed_()
+   , saved_()
+   , resets_()
+{
+   nodes_.reserve(max_nodes_);
+}
+
+MD5PrefixCache::~MD5PrefixCache()
+{
+}
+
+
+MD5::Digest MD5PrefixCache::digest(const char * text, std::size_t length)
+{
+   std::size_t blocks = std::min(length / 64, max_blocks_);
+   if(!blocks) { // Nothing to share
+      misses_.fetch_add(1, std::memory_order_relaxed);
+      hashed_.fetch_add(length, std::memory_order_relaxed);
+      return md5_digest(text, length);
+   }
+
+   // Find the longest cached prefix
+   Key key;
+   MD5 md5;
+   std::size_t cached = 0;
+   unsigned long long generation;
+   {
+      std::shared_lock<std::shared_mutex> guard(mutex_);
+      generation = generation_;
+      key.parent = 0;
+      for(; cached<blocks; ++cached) {
+         std::memcpy(key.block, text + cached * 64, 64);
+         auto it = nodes_.find(key);
+         if(it==nodes_.end()) {
+            break;
+         }
+         key.parent = it->second.id;
+         md5 = MD5(it->second.midstate);
+      }
+   }
+   (cached? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+   saved_.fetch_add(cached * 64, std::memory_order_relaxed);
+   hashed_.fetch_add(length - cached * 64, std::memory_order_relaxed);
+
+   // Hash the rest of the prefix block by block, saving the new states, and then the tail
+   std::vector<MD5::Midstate> midstates;
+   midstates.reserve(blocks - cached);
+   for(std::size_t ii=cached; ii<blocks; ++ii) {
+      md5.update(text + ii * 64, 64);
+      midstates.push_back(md5.midstate());
+   }
+   md5.update(text + blocks * 64, length - blocks * 64);
+   MD5::Digest digest = md5.finalize().binarydigest();
+
+   // Add the new prefixes below the longest cached one
+   if(!midstates.empty()) {
+      std::unique_lock<std::shared_mutex> guard(mutex_);
+      if(generation==generation_) {
+         for(std::size_t ii=0; ii<midstates.size(); ++ii) {
+            if(nodes_.size()>=max_nodes_) { // Full: start again
+               nodes_.clear();
+               sequence_ = 0;
+               ++generation_;
+               resets_.fetch_add(1, std::memory_order_relaxed);
+               break;
+            }
+            std::memcpy(key.block, text + (cached + ii) * 64, 64);
+            auto result = nodes_.emplace(key, Node{sequence_ + 1, midstates[ii]});
+            if(result.second) { // Otherwise another thread has just added it
+               ++sequence_;
+            }
+            key.parent = result.first->second.id;
+         }
+      }
+   }
+   return digest;
+}
+
+
+void MD5PrefixCache::clear()
+{
+   std::unique_lock<std::shared_mutex> guard(mutex_);
+   nodes_.clear();
+   sequence_ = 0;
+   ++generation_;
+}
+
+
+std::size_t MD5PrefixCache::nodes() const
+{
+   std::shared_lock<std::shared_mutex> guard(mutex_);
+   return nodes_.size();
+}
+
+
+std::size_t MD5PrefixCache::memory() const
+{
+   std::shared_lock<std::shared_mutex> guard(mutex_);
+   return nodes_.size() * C_S_NODE_MEMORY;
+}
+
+
+bool MD5PrefixCache::Key::operator==(const Key& other) const
+{
+   return parent==other.parent && !std::memcmp(block, other.block, sizeof(block));
+}
+
+
+std::size_t MD5PrefixCache::KeyHash::operator()(const Key& key) const
+{
+   return std::hash<std::string_view>()(std::string_view(key.block, sizeof(key.block))) ^ (key.parent * 0x9e3779b97f4a7c15ULL);
+}
+
+
+} // namespace lcr
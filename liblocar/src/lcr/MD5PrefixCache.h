@@ -0,0 +1,137 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::MD5PrefixCache
+//  File:        lcr/MD5PrefixCache.h
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_MD5PrefixCache__H_
+#define LIB__lcr_MD5PrefixCache__H_
+
+
+// Stl
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+
+// lib locar
+#include "md5.h"
+
+
+namespace lcr
+{
+
+// This class hashes texts that share long prefixes (e.g. 'tenant/region/bucket/...') without hashing the common
+// prefixes again. It keeps a trie of the 64 byte blocks of the texts already hashed: every node is a prefix made of
+// whole blocks and stores the MD5 state after it, so a new text resumes hashing from its longest cached prefix.
+// The trie is a hash table keyed by (parent node, block). Its memory is bounded: when it is full, it is cleared and
+// it is filled again with the prefixes of the texts that come next.
+class MD5PrefixCache
+{
+   public:
+      // The constructor receives as parameters the memory that the trie may use, in bytes,
+      // and the length of the longest prefix it keeps (longer texts only cache their first blocks)
+      MD5PrefixCache(std::size_t memory, std::size_t max_prefix = C_S_DEFAULT_MAX_PREFIX);
+      virtual ~MD5PrefixCache();
+
+   public:
+      // Public method that returns the digest of a text, resuming from its longest cached prefix
+      // and caching its new prefixes
+      MD5::Digest digest(const char * text, std::size_t length);
+
+      // Public method that removes all the prefixes
+      void clear();
+
+   public:
+      // Getter method that returns the number of prefixes in the trie
+      std::size_t nodes() const;
+
+      // Getter method that returns the memory used by the trie, in bytes
+      std::size_t memory() const;
+
+      // Getter method that returns the number of texts that resumed from a cached prefix
+      unsigned long long hits() const {
+         return hits_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of texts hashed from the start
+      unsigned long long misses() const {
+         return misses_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of bytes hashed
+      unsigned long long bytesHashed() const {
+         return hashed_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of bytes that were not hashed thanks to the cached prefixes
+      unsigned long long bytesSaved() const {
+         return saved_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method that returns the number of times the trie has been cleared because it was full
+      unsigned long long resets() const {
+         return resets_.load(std::memory_order_relaxed);
+      }
+
+   private:
+      // Private class that represents the key of a node: its parent and its last block
+      struct Key
+      {
+         std::uint32_t parent;
+         char block[64];
+
+         bool operator==(const Key& other) const;
+      };
+
+      // Private class that calculates the hash of a key
+      struct KeyHash
+      {
+         std::size_t operator()(const Key& key) const;
+      };
+
+      // Private class that represents a node: a prefix and the MD5 state after it
+      struct Node
+      {
+         std::uint32_t id;
+         MD5::Midstate midstate;
+      };
+
+   private:
+      // Copy constructor (disabled)
+      MD5PrefixCache(const MD5PrefixCache&) = delete;
+      // Assignment operator (disabled)
+      MD5PrefixCache& operator=(const MD5PrefixCache&) = delete;
+
+   public:
+      // The default length of the longest prefix
+      static constexpr std::size_t C_S_DEFAULT_MAX_PREFIX = 4096;
+
+   private:
+      // The estimated memory of a node: the key and the node, plus the link, the cached hash and the bucket of the hash table
+      static constexpr std::size_t C_S_NODE_MEMORY = sizeof(std::pair<const Key, Node>) + 3 * sizeof(void*);
+
+      // The trie and its lock: shared to find prefixes, exclusive to add them
+      std::unordered_map<Key, Node, KeyHash> nodes_;
+      mutable std::shared_mutex mutex_;
+
+      // The limits of the trie
+      std::size_t max_nodes_;
+      std::size_t max_blocks_;
+
+      // The last node identifier (the root, the empty prefix, is zero) and the number of times the trie has been
+      // cleared, so a text does not add nodes under a parent found before a clear
+      std::uint32_t sequence_;
+      unsigned long long generation_;
+
+      // Counters for statistics purposes
+      std::atomic<unsigned long long> hits_;
+      std::atomic<unsigned long long> misses_;
+      std::atomic<unsigned long long> hashed_;
+      std::atomic<unsigned long long> saved_;
+      std::atomic<unsigned long long> resets_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_MD5PrefixCache__H_
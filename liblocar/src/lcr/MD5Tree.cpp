@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------------------------
+//  Class:       lcr::MD5Tree
+//  File:        lcr/MD5Tree.cpp
+//
+//------------------------------------------------------------------------------------------
+#include "MD5Tree.h"
+
+// Stl
+#include <atomic>
+#include <thread>
+#include <system_error>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+
+
+namespace lcr
+{
+
+// The number of leaves that a thread takes at once: enough to fill the widest lanes of md5_many
+static const std::size_t C_S_LEAVES_PER_BATCH = 16;
+
+
+// Function that returns the helper threads that the trees can still start: one less than the CPUs, as the calling
+// threads hash too, shared by all the trees so concurrent digests never run more threads than the CPUs among them
+static std::atomic<unsigned int>& helpers()
+{
+   static std::atomic<unsigned int> helpers(std::max(1u, std::thread::hardware_concurrency()) - 1);
+   return helpers;
+}
+
+// Function that takes up to 'wanted' helper threads from the budget, and returns the number taken
+static unsigned int take_helpers(unsigned int wanted)
+{
+   unsigned int available = helpers().load(std::memory_order_relaxed);
+   while(available && !helpers().compare_exchange_weak(available, available - std::min(available, wanted), std::memory_order_relaxed)) {
+   }
+   return std::min(available, wanted);
+}
+
+// Function that returns helper threads to the budget
+static void give_helpers(unsigned int count)
+{
+   helpers().fetch_add(count, std::memory_order_relaxed);
+}
+
+
+MD5Tree::MD5Tree(std::size_t leaf_size, unsigned int threads)
+   : leaf_size_(std::max<std::size_t>(64, leaf_size))
+   , threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+MD5Tree::~MD5Tree()
+{
+}
+
+
+MD5::Digest MD5Tree::digest(const char * data, std::size_t length) const
+{
+   std::vector<MD5::Digest> digests((length + leaf_size_ - 1) / leaf_size_);
+   leaves(data, length, digests.data());
+   return root(digests.data(), digests.size());
+}
+
+
+void MD5Tree::leaves(const char * data, std::size_t length, MD5::Digest * digests) const
+{
+   std::size_t leaves = (length + leaf_size_ - 1) / leaf_size_;
+
+   // Every thread takes batches of consecutive leaves and hashes them in the lanes of md5_many. The batches are
+   // smaller when there are few leaves (a chunk of a file), so they are still spread among the threads
+   std::size_t batch = std::max<std::size_t>(1, std::min(C_S_LEAVES_PER_BATCH, (leaves + threads_ - 1) / threads_));
+   std::atomic<std::size_t> next(0);
+   auto work = [&]() {
+      std::string_view texts[C_S_LEAVES_PER_BATCH];
+      for(std::size_t first; (first = next.fetch_add(batch, std::memory_order_relaxed)) < leaves; ) {
+         std::size_t count = std::min(batch, leaves - first);
+         for(std::size_t ii=0; ii<count; ++ii) {
+            std::size_t offset = (first + ii) * leaf_size_;
+            texts[ii] = std::string_view(data + offset, std::min(leaf_size_, length - offset));
+         }
+         md5_many(texts, digests + first, count);
+      }
+   };
+   // The helpers come from the shared budget, and the calling thread works as well. If a thread can not be started
+   // (the limit of threads of the process), the digest goes on with the threads already running
+   std::size_t batches = (leaves + batch - 1) / batch;
+   unsigned int taken = (batches>1) ? take_helpers(static_cast<unsigned int>(std::min<std::size_t>(threads_, batches) - 1)) : 0;
+   std::vector<std::thread> threads;
+   threads.reserve(taken);
+   try {
+      while(threads.size()<taken) {
+         threads.emplace_back(work);
+      }
+   }
+   catch(const std::system_error&) {
+      give_helpers(taken - static_cast<unsigned int>(threads.size()));
+      taken = static_cast<unsigned int>(threads.size());
+   }
+   work();
+   for(auto& thread : threads) {
+      thread.join();
+   }
+   give_helpers(taken);
+}
+
+
+MD5::Digest MD5Tree::root(const MD5::Digest * digests, std::size_t count) const
+{
+   // The root: the leaf size and then the digests of the leaves
+   unsigned char header[8];
+   for(unsigned int ii=0; ii<8; ++ii) {
+      header[ii] = static_cast<unsigned char>(static_cast<std::uint64_t>(leaf_size_) >> (8 * ii));
+   }
+   MD5 root;
+   root.update(reinterpret_cast<const char *>(header), sizeof(header));
+   root.update(reinterpret_cast<const char *>(digests), count * sizeof(MD5::Digest));
+   return root.finalize().binarydigest();
+}
+
+
+MD5::Digest md5_tree(const char * data, std::size_t length)
+{
+   static const MD5Tree tree;
+   return tree.digest(data, length);
+}
+
+
+} // namespace lcr
@@ -0,0 +1,85 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::MD5Tree
+//  File:        lcr/MD5Tree.h
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_MD5Tree__H_
+#define LIB__lcr_MD5Tree__H_
+
+
+// Stl
+#include <string>
+#include <cstdint>
+
+// lib locar
+#include "md5.h"
+
+
+namespace lcr
+{
+
+// This class calculates the MD5 tree hash of an input: a fingerprint for large objects that, unlike plain MD5,
+// can use all the cores. The input is split in leaves of a fixed size (the last one may be shorter), the leaves are
+// hashed with MD5 in parallel, and the root is the MD5 of the leaf size followed by the digests of the leaves:
+//
+//    root = MD5( leaf_size as 8 bytes little endian || MD5(leaf 0) || MD5(leaf 1) || ... )
+//
+// The result depends on the leaf size and it is never equal to the plain MD5 of the input, so it must be
+// presented as a different kind of digest.
+class MD5Tree
+{
+   public:
+      // The constructor receives as parameters the leaf size, in bytes, and the most hashing threads of a digest
+      // (zero for one per CPU): the calling thread and helpers taken from a budget of one less than the CPUs, shared
+      // by all the trees of the process, so a digest gets fewer when others are running
+      MD5Tree(std::size_t leaf_size = C_S_DEFAULT_LEAF_SIZE, unsigned int threads = 0);
+      virtual ~MD5Tree();
+
+   public:
+      // Public method that returns the tree hash of an input
+      MD5::Digest digest(const char * data, std::size_t length) const;
+
+      // Public method that hashes the leaves of a part of an input, so an input that is not in memory can be hashed
+      // in chunks: the part starts at a leaf boundary and holds whole leaves, except at the end of the input, where
+      // the last one may be shorter. The digests of its leaves are written in 'digests'
+      void leaves(const char * data, std::size_t length, MD5::Digest * digests) const;
+
+      // Public method that returns the root from the digests of all the leaves of an input
+      MD5::Digest root(const MD5::Digest * digests, std::size_t count) const;
+
+   public:
+      // Getter method that returns the leaf size
+      std::size_t leafSize() const {
+         return leaf_size_;
+      }
+
+      // Getter method that returns the number of hashing threads
+      unsigned int threads() const {
+         return threads_;
+      }
+
+   public:
+      // The default leaf size: 1 MB
+      static constexpr std::size_t C_S_DEFAULT_LEAF_SIZE = 1024 * 1024;
+
+   private:
+      // Copy constructor (disabled)
+      MD5Tree(const MD5Tree&) = delete;
+      // Assignment operator (disabled)
+      MD5Tree& operator=(const MD5Tree&) = delete;
+
+   private:
+      // The size of the leaves
+      std::size_t leaf_size_;
+
+      // The number of hashing threads
+      unsigned int threads_;
+};
+
+// Function that returns the tree hash of an input with the default leaf size, using all the CPUs
+MD5::Digest md5_tree(const char * data, std::size_t length);
+
+} // namespace lcr
+
+#endif // LIB__lcr_MD5Tree__H_
@@ -0,0 +1,101 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::StatisticsResource
+//  File:        lcr/MemoryResource.hpp
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_MemoryResource__HPP_
+#define LIB__lcr_MemoryResource__HPP_
+
+
+// Stl
+#include <atomic>
+#include <memory_resource>
+
+
+namespace lcr
+{
+
+// This class represents a polymorphic memory resource that forwards every request to an upstream resource
+// and keeps track of the number of allocations and the bytes in use. Chained before and after a pool resource,
+// it measures the memory requested by the pool clients versus the memory that the pool keeps from the system.
+class StatisticsResource : public std::pmr::memory_resource
+{
+   public:
+      // The constructor receives as parameter the upstream resource
+      explicit StatisticsResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+         : upstream_(upstream)
+         , allocations_()
+         , deallocations_()
+         , bytes_()
+         , peak_()
+      {}
+
+      // Destroyer
+      virtual ~StatisticsResource()
+      {}
+
+   public:
+      // Getter method for the total number of allocations
+      unsigned long long allocations() const {
+         return allocations_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method for the total number of deallocations
+      unsigned long long deallocations() const {
+         return deallocations_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method for the bytes currently allocated
+      std::size_t bytes() const {
+         return bytes_.load(std::memory_order_relaxed);
+      }
+
+      // Getter method for the maximum number of bytes allocated at the same time
+      std::size_t peak() const {
+         return peak_.load(std::memory_order_relaxed);
+      }
+
+   private:
+      // Method that allocates memory from the upstream resource
+      void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+         void* p = upstream_->allocate(bytes, alignment);
+         allocations_.fetch_add(1, std::memory_order_relaxed);
+         std::size_t current = bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+         std::size_t peak = peak_.load(std::memory_order_relaxed);
+         while(current > peak && !peak_.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+         return p;
+      }
+
+      // Method that returns memory to the upstream resource
+      void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+         upstream_->deallocate(p, bytes, alignment);
+         deallocations_.fetch_add(1, std::memory_order_relaxed);
+         bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+      }
+
+      // Method that compares resources: memory allocated from one can only be deallocated by itself
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+         return this == &other;
+      }
+
+   private:
+      // Copy constructor (disabled)
+      StatisticsResource(const StatisticsResource&) = delete;
+      // Assignment operator (disabled)
+      StatisticsResource& operator=(const StatisticsResource&) = delete;
+
+   private:
+      // The upstream resource
+      std::pmr::memory_resource* upstream_;
+
+      // Counters for statistics purposes
+      std::atomic<unsigned long long> allocations_;
+      std::atomic<unsigned long long> deallocations_;
+      std::atomic<std::size_t> bytes_;
+      std::atomic<std::size_t> peak_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_MemoryResource__HPP_
@@ -0,0 +1,225 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::NearCache
+//  File:        lcr/NearCache.hpp
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_NearCache__HPP_
+#define LIB__lcr_NearCache__HPP_
+
+
+// Stl
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+// Posix
+#include <sched.h>
+
+
+namespace lcr
+{
+
+// This template class represents a small near cache (L1) placed in front of a shared cache.
+// It is split in one shard per CPU, each one a 2-way set associative table guarded by its own flag,
+// so the threads running on a CPU keep hot entries in cache lines that are not shared with other CPUs.
+// Every entry is stamped with the generation of the shared cache when it was copied: the owner bumps
+// its generation when many entries become invalid at once (clear, expiry) and stale entries stop matching.
+// A single key that becomes invalid (overwrite, eviction) is dropped from every shard with invalidate().
+// Entries are also refreshed from the shared cache after a short period, so its access times stay current.
+template <class KEY, class DATA, class HASH = std::hash<KEY>>
+class NearCache
+{
+   public:
+      // The constructor receives as parameters the number of entries per shard and the refresh period
+      NearCache(std::size_t entries, std::chrono::milliseconds refresh)
+         : sets_(size_for_(entries) / C_S_WAYS)
+         , refresh_(refresh)
+         , shards_(std::max(1u, std::thread::hardware_concurrency()))
+      {
+         for(auto& shard : shards_) {
+            shard.slots.resize(sets_ * C_S_WAYS);
+            shard.lru.resize(sets_);
+         }
+      }
+
+      // Destroyer
+      virtual ~NearCache()
+      {}
+
+   public:
+      // Public getter method that finds the data associated with the key, only if it belongs to the generation passed as parameter
+      bool get(const KEY& key, unsigned long long generation, DATA& data) const {
+         Shard& shard = current_shard_();
+         if(shard.busy.test_and_set(std::memory_order_acquire)) { // Another thread on this CPU owns the shard: bypass it
+            return false;
+         }
+         bool found = false;
+         std::size_t set = (HASH()(key) % sets_) * C_S_WAYS;
+         auto now = std::chrono::steady_clock::now();
+         for(std::size_t ii=set; ii<set+C_S_WAYS; ++ii) {
+            Slot& slot = shard.slots[ii];
+            if(slot.valid && slot.generation==generation && slot.key==key) {
+               if(now - slot.filled < refresh_) {
+                  data = slot.data;
+                  shard.lru[set / C_S_WAYS] = static_cast<unsigned char>(ii - set);
+                  found = true;
+               }
+               else {
+                  slot.valid = false;
+               }
+               break;
+            }
+         }
+         shard.busy.clear(std::memory_order_release);
+         (found? shard.hits : shard.misses).fetch_add(1, std::memory_order_relaxed);
+         return found;
+      }
+
+      // Public setter method that stores a copy of the data associated with the key, stamped with the generation passed as parameter
+      void set(const KEY& key, const DATA& data, unsigned long long generation) {
+         Shard& shard = current_shard_();
+         if(shard.busy.test_and_set(std::memory_order_acquire)) {
+            return;
+         }
+         std::size_t set = (HASH()(key) % sets_) * C_S_WAYS;
+         std::size_t victim = set + (shard.lru[set / C_S_WAYS] ^ 1); // Replace the least recently used way
+         for(std::size_t ii=set; ii<set+C_S_WAYS; ++ii) {
+            if(shard.slots[ii].valid && shard.slots[ii].key==key) {
+               victim = ii;
+               break;
+            }
+         }
+         Slot& slot = shard.slots[victim];
+         slot.key = key;
+         slot.data = data;
+         slot.generation = generation;
+         slot.filled = std::chrono::steady_clock::now();
+         slot.valid = true;
+         shard.lru[set / C_S_WAYS] = static_cast<unsigned char>(victim - set);
+         shard.busy.clear(std::memory_order_release);
+      }
+
+      // Public method that drops the copies of a key from every shard, waiting for the shards in use. The owner must
+      // call it while no copy of the key can be stored (under its lock), or a copy of the old data could come back
+      void invalidate(const KEY& key) {
+         std::size_t set = (HASH()(key) % sets_) * C_S_WAYS;
+         for(auto& shard : shards_) {
+            while(shard.busy.test_and_set(std::memory_order_acquire)) { // Held for a lookup or a copy: a few nanoseconds
+               std::this_thread::yield();
+            }
+            for(std::size_t ii=set; ii<set+C_S_WAYS; ++ii) {
+               if(shard.slots[ii].valid && shard.slots[ii].key==key) {
+                  shard.slots[ii].valid = false;
+               }
+            }
+            shard.busy.clear(std::memory_order_release);
+         }
+      }
+
+   public:
+      // Getter method that returns the number of entries of each shard
+      std::size_t entries() const {
+         return sets_ * C_S_WAYS;
+      }
+
+      // Getter method that returns the number of shards
+      std::size_t shards() const {
+         return shards_.size();
+      }
+
+      // Getter method that returns the accumulated number of hits
+      unsigned long long hits() const {
+         unsigned long long hits = 0;
+         for(const auto& shard : shards_) {
+            hits += shard.hits.load(std::memory_order_relaxed);
+         }
+         return hits;
+      }
+
+      // Getter method that returns the accumulated number of misses
+      unsigned long long misses() const {
+         unsigned long long misses = 0;
+         for(const auto& shard : shards_) {
+            misses += shard.misses.load(std::memory_order_relaxed);
+         }
+         return misses;
+      }
+
+      // Public method to clear the statistics
+      void clearStatistics() {
+         for(auto& shard : shards_) {
+            shard.hits = 0;
+            shard.misses = 0;
+         }
+      }
+
+   private:
+      // Private class that represents an entry copied from the shared cache
+      struct Slot
+      {
+         KEY key;
+         DATA data;
+         unsigned long long generation{};
+         std::chrono::steady_clock::time_point filled;
+         bool valid{};
+      };
+
+      // Private class that represents the table of a CPU, aligned to avoid false sharing with its neighbours
+      struct alignas(64) Shard
+      {
+         std::atomic_flag busy = ATOMIC_FLAG_INIT;
+         std::vector<Slot> slots;
+         std::vector<unsigned char> lru; // The most recently used way of each set
+         std::atomic<unsigned long long> hits{};
+         std::atomic<unsigned long long> misses{};
+      };
+
+   private:
+      // Private method that returns the shard of the CPU the calling thread is running on
+      Shard& current_shard_() const {
+         int cpu = sched_getcpu();
+         if(cpu<0) {
+            cpu = static_cast<int>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+         }
+         return shards_[static_cast<unsigned int>(cpu) % shards_.size()];
+      }
+
+      // Private method that calculates the number of entries: a power of two between the allowed limits
+      static std::size_t size_for_(std::size_t entries) {
+         std::size_t size = C_S_MIN_ENTRIES;
+         while(size < entries && size < C_S_MAX_ENTRIES) {
+            size <<= 1;
+         }
+         return size;
+      }
+
+   private:
+      // Copy constructor (disabled)
+      NearCache(const NearCache&) = delete;
+      // Assignment operator (disabled)
+      NearCache& operator=(const NearCache&) = delete;
+
+   private:
+      // The table associativity
+      static constexpr std::size_t C_S_WAYS = 2;
+      // The limits for the number of entries per shard
+      static constexpr std::size_t C_S_MIN_ENTRIES = 16;
+      static constexpr std::size_t C_S_MAX_ENTRIES = 4096;
+
+      // The number of sets per shard
+      std::size_t sets_;
+
+      // The period after which an entry must be refreshed from the shared cache
+      std::chrono::milliseconds refresh_;
+
+      // The per CPU tables
+      mutable std::vector<Shard> shards_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_NearCache__HPP_
@@ -12,6 +12,7 @@
 
 // Componentes
 #include "String.hpp"
+#include "Timestamp.hpp"
 
 
 namespace lcr
@@ -20,7 +21,6 @@ namespace lcr
 
 StdLogger::StdLogger()
    : Logger()
-   , level_(3)
    , buffer_()
    , mutex_()
 {
@@ -31,6 +31,16 @@ StdLogger::~StdLogger()
 }
 
 
+// Function that returns the current timestamp, from a cache of the calling thread that is reformatted once per second
+static const char * timestamp()
+{
+   static thread_local Timestamp cache;
+   static thread_local char text[Timestamp::C_S_SIZE];
+   text[cache.now(text)] = '\0';
+   return text;
+}
+
+
 void StdLogger::trace(unsigned int level, const char * file, unsigned int line, const char * fmt, ...)
 {
    if(level<=level_) {
@@ -39,7 +49,7 @@ void StdLogger::trace(unsigned int level, const char * file, unsigned int line,
       std::lock_guard<std::mutex> guard(mutex_);
       vsnprintf(buffer_, sizeof(buffer_), fmt, args);
       va_end(args);
-      std::cout << "- " << string::timestamp() << " T" << level << ": " << buffer_ << "  [" << file << " +" << line << "]" << std::endl;
+      std::cout << "- " << timestamp() << " T" << level << ": " << buffer_ << "  [" << file << " +" << line << "]" << std::endl;
    }
 }
 
@@ -63,7 +73,7 @@ void StdLogger::error(unsigned int level, const char * file, unsigned int line,
          header = " WARNING: ";
          break;
    }
-   std::cerr << "- " << string::timestamp() << header << buffer_ << "  [" << file << " +" << line << "]" << std::endl;
+   std::cerr << "- " << timestamp() << header << buffer_ << "  [" << file << " +" << line << "]" << std::endl;
 }
 
 
@@ -51,8 +51,6 @@ class StdLogger : public Logger
       StdLogger& operator=(const StdLogger&)= delete;
 
    private:
-      // The logger current level
-      std::atomic<unsigned int> level_;
       // Internal buffer to parse messages
       char buffer_[8192];
       // The buffer mutex
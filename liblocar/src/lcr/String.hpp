@@ -114,6 +114,22 @@ static inline std::string to_string(const T& data) {
    }
 
 
+   // Utility function that returns the values of the bytes of a buffer, e.g. "[103] [101] [116] ", or "<empty>"
+   static inline std::string dump_bytes(const char * buffer, std::size_t length) {
+      if(!length) {
+         return "<empty>";
+      }
+      std::string dump;
+      dump.reserve(length * 6);
+      for(std::size_t ii=0; ii<length; ++ii) {
+         dump += '[';
+         dump += std::to_string(static_cast<unsigned char>(buffer[ii]));
+         dump += "] ";
+      }
+      return dump;
+   }
+
+
    } // namespace string
 } // namespace lcr
 
@@ -0,0 +1,73 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::Timestamp
+//  File:        lcr/Timestamp.hpp
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_Timestamp__HPP_
+#define LIB__lcr_Timestamp__HPP_
+
+
+// Stl
+#include <ctime>
+#include <chrono>
+#include <cstring>
+
+
+namespace lcr
+{
+
+// This class formats the timestamps of the log lines: "2024 Jan 31 23:59:59.999". The date and the time are formatted
+// with localtime_r and strftime only when the second changes (localtime takes a global lock in glibc and may check the
+// time zone file), and the milliseconds are appended with a few integer operations.
+// An instance is not thread safe: keep one per thread (e.g. thread_local).
+class Timestamp
+{
+   public:
+      // Constructor
+      Timestamp()
+         : second_(-1)
+         , length_()
+         , text_()
+      {}
+
+   public:
+      // Public method that formats a time point into the buffer (at least C_S_SIZE chars) and returns its length,
+      // without null terminator
+      std::size_t format(std::chrono::system_clock::time_point time, char * out) {
+         auto since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+         std::time_t second = static_cast<std::time_t>(since_epoch / 1000);
+         unsigned int millis = static_cast<unsigned int>(since_epoch % 1000);
+         if(second!=second_) {
+            struct tm local;
+            localtime_r(&second, &local);
+            length_ = strftime(text_, sizeof(text_), "%Y %b %d %H:%M:%S", &local);
+            second_ = second;
+         }
+         std::memcpy(out, text_, length_);
+         out[length_] = '.';
+         out[length_ + 1] = static_cast<char>('0' + millis / 100);
+         out[length_ + 2] = static_cast<char>('0' + millis / 10 % 10);
+         out[length_ + 3] = static_cast<char>('0' + millis % 10);
+         return length_ + 4;
+      }
+
+      // Public method that formats the current time
+      std::size_t now(char * out) {
+         return format(std::chrono::system_clock::now(), out);
+      }
+
+   public:
+      // The size of the buffer for a formatted timestamp
+      static constexpr std::size_t C_S_SIZE = 48;
+
+   private:
+      // The second whose date and time are cached, and their text
+      std::time_t second_;
+      std::size_t length_;
+      char text_[C_S_SIZE - 4];
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_Timestamp__HPP_
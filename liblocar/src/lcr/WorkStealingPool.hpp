@@ -0,0 +1,201 @@
+//---------------------------------------------------------------------------
+//  Class:       lcr::WorkStealingPool<TASK>
+//  File:        lcr/WorkStealingPool.hpp
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_WorkStealingPool__HPP_
+#define LIB__lcr_WorkStealingPool__HPP_
+
+
+// Stl
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <functional>
+
+
+namespace lcr
+{
+
+// This template class represents a pool of threads that run tasks which can create new tasks, as a recursive walk does.
+// Every thread owns a queue: it pushes the tasks it creates at the back and takes its next task from the back too, so
+// it goes depth first over the data it has just touched. A thread whose queue is empty steals the oldest task from the
+// front of another queue, which tends to be the largest pending piece of work. The run ends when no task is pending.
+template <class TASK>
+class WorkStealingPool
+{
+   public:
+      // Type of the function that executes a task: it receives the task and the index of the thread that runs it,
+      // which is the one to pass to push() for the new tasks
+      typedef std::function<void(TASK&, unsigned int)> Executor;
+
+   public:
+      // The constructor receives as parameters the number of threads and the function that executes the tasks
+      WorkStealingPool(unsigned int threads, Executor executor)
+         : executor_(executor)
+         , queues_(std::max(1u, threads))
+         , pending_()
+         , steals_()
+         , cancelled_()
+         , error_()
+         , error_mutex_()
+      {}
+
+      // Destroyer
+      virtual ~WorkStealingPool()
+      {}
+
+   public:
+      // Public method that runs the initial tasks and every task created from them, and returns when all have finished.
+      // The first exception thrown by a task stops the run and is rethrown here.
+      void run(std::vector<TASK> tasks) {
+         for(std::size_t ii=0; ii<tasks.size(); ++ii) {
+            push(std::move(tasks[ii]), ii % queues_.size());
+         }
+         std::vector<std::thread> threads;
+         for(unsigned int ii=1; ii<queues_.size(); ++ii) {
+            threads.emplace_back(&WorkStealingPool::work_, this, ii);
+         }
+         work_(0);
+         for(auto& thread : threads) {
+            thread.join();
+         }
+         if(error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            cancelled_ = false;
+            std::rethrow_exception(error);
+         }
+      }
+
+      // Public method that adds a task to the queue of a thread: tasks call it with the index they received
+      void push(TASK task, unsigned int thread) {
+         Queue& queue = queues_[thread];
+         std::lock_guard<std::mutex> guard(queue.mutex);
+         if(!cancelled_) {
+            pending_.fetch_add(1, std::memory_order_relaxed);
+            queue.tasks.push_back(std::move(task));
+         }
+      }
+
+   public:
+      // Getter method that returns the number of threads
+      unsigned int threads() const {
+         return static_cast<unsigned int>(queues_.size());
+      }
+
+      // Getter method that returns the number of tasks taken from the queue of another thread
+      unsigned long long steals() const {
+         return steals_.load(std::memory_order_relaxed);
+      }
+
+   private:
+      // Private class that represents the queue of a thread, aligned to avoid false sharing with its neighbours
+      struct alignas(64) Queue
+      {
+         std::mutex mutex;
+         std::deque<TASK> tasks;
+      };
+
+   private:
+      // Private method with the main loop of a thread
+      void work_(unsigned int thread) {
+         unsigned int idle = 0;
+         TASK task;
+         while(pending_.load(std::memory_order_acquire)) {
+            if(!pop_(thread, task) && !steal_(thread, task)) {
+               // Every queue is empty, but the running tasks may still create new ones
+               if(++idle < 64) {
+                  std::this_thread::yield();
+               }
+               else {
+                  std::this_thread::sleep_for(std::chrono::microseconds(100));
+               }
+               continue;
+            }
+            idle = 0;
+            try {
+               executor_(task, thread);
+            }
+            catch(...) {
+               std::lock_guard<std::mutex> guard(error_mutex_);
+               if(!error_) {
+                  error_ = std::current_exception();
+                  cancel_();
+               }
+            }
+            pending_.fetch_sub(1, std::memory_order_release);
+         }
+      }
+
+      // Private method that takes the newest task of the own queue
+      bool pop_(unsigned int thread, TASK& task) {
+         Queue& queue = queues_[thread];
+         std::lock_guard<std::mutex> guard(queue.mutex);
+         if(queue.tasks.empty()) {
+            return false;
+         }
+         task = std::move(queue.tasks.back());
+         queue.tasks.pop_back();
+         return true;
+      }
+
+      // Private method that takes the oldest task of the queue of another thread, visiting them from the next one
+      bool steal_(unsigned int thread, TASK& task) {
+         for(std::size_t ii=1; ii<queues_.size(); ++ii) {
+            Queue& queue = queues_[(thread + ii) % queues_.size()];
+            std::lock_guard<std::mutex> guard(queue.mutex);
+            if(!queue.tasks.empty()) {
+               task = std::move(queue.tasks.front());
+               queue.tasks.pop_front();
+               steals_.fetch_add(1, std::memory_order_relaxed);
+               return true;
+            }
+         }
+         return false;
+      }
+
+      // Private method that discards the queued tasks after an error: from now on, new tasks are discarded too
+      void cancel_() {
+         cancelled_ = true;
+         for(auto& queue : queues_) {
+            std::lock_guard<std::mutex> guard(queue.mutex);
+            pending_.fetch_sub(queue.tasks.size(), std::memory_order_relaxed);
+            queue.tasks.clear();
+         }
+      }
+
+   private:
+      // Copy constructor (disabled)
+      WorkStealingPool(const WorkStealingPool&) = delete;
+      // Assignment operator (disabled)
+      WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+   private:
+      // The function that executes the tasks
+      Executor executor_;
+
+      // The queue of every thread
+      std::vector<Queue> queues_;
+
+      // The number of tasks queued or running
+      std::atomic<std::size_t> pending_;
+
+      // Counter for statistics purposes
+      std::atomic<unsigned long long> steals_;
+
+      // The first exception thrown by a task, which cancels the run
+      std::atomic<bool> cancelled_;
+      std::exception_ptr error_;
+      std::mutex error_mutex_;
+};
+
+} // namespace lcr
+
+#endif // LIB__lcr_WorkStealingPool__HPP_
@@ -35,71 +35,155 @@ documentation and/or software.
  
 /* system implementation headers */
 #include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* multi-buffer kernels and the step template shared with them */
+#include "md5_kernels.h"
+#include "md5_lanes.hpp"
+#include "md5_constexpr.hpp"
  
  
-namespace lcr
+namespace
 {
 
-// Constants for MD5Transform routine.
-#define S11 7
-#define S12 12
-#define S13 17
-#define S14 22
-#define S21 5
-#define S22 9
-#define S23 14
-#define S24 20
-#define S31 4
-#define S32 11
-#define S33 16
-#define S34 23
-#define S41 6
-#define S42 10
-#define S43 15
-#define S44 21
- 
-///////////////////////////////////////////////
- 
-// F, G, H and I are basic MD5 functions.
-inline MD5::uint4 MD5::F(uint4 x, uint4 y, uint4 z) {
-  return x&y | ~x&z;
-}
- 
-inline MD5::uint4 MD5::G(uint4 x, uint4 y, uint4 z) {
-  return x&z | y&~z;
-}
- 
-inline MD5::uint4 MD5::H(uint4 x, uint4 y, uint4 z) {
-  return x^y^z;
+// the RFC 1321 test suite, checked at compile time: the constant tables shared by
+// all the kernels are the ones that produced these digests
+static_assert(lcr::md5_equals(lcr::md5_constexpr(""), "d41d8cd98f00b204e9800998ecf8427e"), "MD5 test vector");
+static_assert(lcr::md5_equals(lcr::md5_constexpr("a"), "0cc175b9c0f1b6a831c399e269772661"), "MD5 test vector");
+static_assert(lcr::md5_equals(lcr::md5_constexpr("abc"), "900150983cd24fb0d6963f7d28e17f72"), "MD5 test vector");
+static_assert(lcr::md5_equals(lcr::md5_constexpr("message digest"), "f96b697d7cb7938d525a2f31aaf161d0"), "MD5 test vector");
+static_assert(lcr::md5_equals(lcr::md5_constexpr("abcdefghijklmnopqrstuvwxyz"), "c3fcd3d76192e4007dfb496cca67e13b"), "MD5 test vector");
+static_assert(lcr::md5_equals(lcr::md5_constexpr("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"),
+                              "d174ab98d277d9f5a5611c2c9f419d9f"), "MD5 test vector");
+static_assert(lcr::md5_equals(lcr::md5_constexpr("12345678901234567890123456789012345678901234567890123456789012345678901234567890"),
+                              "57edf4a22be3c955ac49da2e2107b67a"), "MD5 test vector");
+
+// Scalar operations for the step template: F and G use the boolean
+// simplifications (d ^ (b & (c ^ d)) and c ^ (d & (b ^ c))), which save
+// one operation each over the RFC formulation
+struct Scalar
+{
+  typedef std::uint32_t type;
+
+  static inline type set1(std::uint32_t a) { return a; }
+  static inline type add(type a, type b) { return a + b; }
+  template <unsigned int S>
+  static inline type rotl(type a) { return (a << S) | (a >> (32 - S)); }
+
+  static inline type f(type b, type c, type d) { return d ^ (b & (c ^ d)); }
+  static inline type g(type b, type c, type d) { return c ^ (d & (b ^ c)); }
+  static inline type h(type b, type c, type d) { return b ^ c ^ d; }
+  static inline type i(type b, type c, type d) { return c ^ (b | ~d); }
+};
+
+// unaligned little endian load of a 32 bit word
+inline std::uint32_t load_le32(const unsigned char *p)
+{
+  std::uint32_t word;
+  std::memcpy(&word, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap32(word);
+#endif
+  return word;
 }
- 
-inline MD5::uint4 MD5::I(uint4 x, uint4 y, uint4 z) {
-  return y ^ (x | ~z);
+
+// a kernel that md5_many can be bound to
+struct Binding
+{
+  lcr::MD5Kernel kernel;
+  const char *name;
+  unsigned int lanes;
+  lcr::md5_kernels::batch_kernel batch; // null for the scalar code
+};
+
+// the kernels, indexed by lcr::MD5Kernel and ordered from the slowest to the fastest
+const Binding *bindings()
+{
+  static const Binding table[] = {
+    { lcr::MD5Kernel::scalar, "scalar", 1, nullptr },
+    { lcr::MD5Kernel::sse2, "sse2", 4, lcr::md5_kernels::sse2 },
+    { lcr::MD5Kernel::avx2, "avx2", 8, lcr::md5_kernels::avx2 },
+    { lcr::MD5Kernel::avx512, "avx512", 16, lcr::md5_kernels::avx512 }
+  };
+  return table;
 }
- 
-// rotate_left rotates x left n bits.
-inline MD5::uint4 MD5::rotate_left(uint4 x, int n) {
-  return (x << n) | (x >> (32-n));
+const int kernels = 4;
+
+// true if the kernel has been compiled in and the CPU supports it
+bool supported(const Binding &binding)
+{
+  if (binding.kernel == lcr::MD5Kernel::scalar)
+    return true;
+  if (!binding.batch)
+    return false;
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init(); // we may run before the static constructors
+  switch (binding.kernel) {
+    case lcr::MD5Kernel::sse2: return __builtin_cpu_supports("sse2");
+    case lcr::MD5Kernel::avx2: return __builtin_cpu_supports("avx2");
+    case lcr::MD5Kernel::avx512: return __builtin_cpu_supports("avx512f");
+    default: break;
+  }
+#endif
+  return false;
 }
- 
-// FF, GG, HH, and II transformations for rounds 1, 2, 3, and 4.
-// Rotation is separate from addition to prevent recomputation.
-inline void MD5::FF(uint4 &a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac) {
-  a = rotate_left(a+ F(b,c,d) + x + ac, s) + b;
+
+// the environment override if it is supported, the fastest supported kernel otherwise
+const Binding *detect()
+{
+  lcr::MD5Kernel kernel;
+  const char *name = std::getenv("LCR_MD5_KERNEL");
+  if (name && lcr::md5_kernel_from_name(name, kernel) && supported(bindings()[static_cast<int>(kernel)]))
+    return &bindings()[static_cast<int>(kernel)];
+  for (int i = kernels - 1; i > 0; i--)
+    if (supported(bindings()[i]))
+      return &bindings()[i];
+  return &bindings()[0];
 }
- 
-inline void MD5::GG(uint4 &a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac) {
-  a = rotate_left(a + G(b,c,d) + x + ac, s) + b;
+
+// the kernel bound to md5_many
+std::atomic<const Binding *> &bound()
+{
+  static std::atomic<const Binding *> binding(detect());
+  return binding;
 }
- 
-inline void MD5::HH(uint4 &a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac) {
-  a = rotate_left(a + H(b,c,d) + x + ac, s) + b;
+
+// hex representation of a binary digest (32 chars, not null terminated)
+inline void to_hex(const unsigned char digest[16], char hex[32])
+{
+#ifdef __SSE2__
+  // split the bytes in nibbles, interleave them (high nibble first) and map every
+  // nibble n to '0' + n, adding the distance to 'a' where n > 9: no branches, no table
+  const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(digest));
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+  const __m128i low = _mm_and_si128(bytes, mask);
+  auto ascii = [](__m128i n) {
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letters);
+  };
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(hex), ascii(_mm_unpacklo_epi8(high, low)));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(hex + 16), ascii(_mm_unpackhi_epi8(high, low)));
+#else
+  static const char digits[] = "0123456789abcdef";
+  for (int i = 0; i < 16; i++) {
+    hex[2*i] = digits[digest[i] >> 4];
+    hex[2*i+1] = digits[digest[i] & 0x0f];
+  }
+#endif
 }
+
+} // namespace
  
-inline void MD5::II(uint4 &a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac) {
-  a = rotate_left(a + I(b,c,d) + x + ac, s) + b;
-}
  
+namespace lcr
+{
+
 //////////////////////////////////////////////
  
 // default ctor, just initailize
@@ -118,30 +202,40 @@ MD5::MD5(const std::string &text)
   finalize();
 }
  
-//////////////////////////////
+//////////////////////////////////////////////
  
-void MD5::init()
+// resume ctor: continues hashing after a prefix whose state was saved with midstate()
+MD5::MD5(const Midstate &midstate)
 {
-  finalized=false;
+  init();
+  count = midstate.count;
+  memcpy(state, midstate.state, sizeof state);
+}
  
-  count[0] = 0;
-  count[1] = 0;
+//////////////////////////////
  
-  // load magic initialization constants.
-  state[0] = 0x67452301;
-  state[1] = 0xefcdab89;
-  state[2] = 0x98badcfe;
-  state[3] = 0x10325476;
+MD5::Midstate MD5::midstate() const
+{
+  Midstate midstate;
+  memcpy(midstate.state, state, sizeof state);
+  midstate.count = count;
+ 
+  return midstate;
 }
  
 //////////////////////////////
  
-// decodes input (unsigned char) into output (uint4). Assumes len is a multiple of 4.
-void MD5::decode(uint4 output[], const uint1 input[], size_type len)
+void MD5::init()
 {
-  for (unsigned int i = 0, j = 0; j < len; i++, j += 4)
-    output[i] = ((uint4)input[j]) | (((uint4)input[j+1]) << 8) |
-      (((uint4)input[j+2]) << 16) | (((uint4)input[j+3]) << 24);
+  finalized=false;
+ 
+  count = 0;
+ 
+  // load magic initialization constants.
+  state[0] = MD5Constants::IV[0];
+  state[1] = MD5Constants::IV[1];
+  state[2] = MD5Constants::IV[2];
+  state[3] = MD5Constants::IV[3];
 }
  
 //////////////////////////////
@@ -160,91 +254,22 @@ void MD5::encode(uint1 output[], const uint4 input[], size_type len)
  
 //////////////////////////////
  
-// apply MD5 algo on a block
-void MD5::transform(const uint1 block[blocksize])
-{
-  uint4 a = state[0], b = state[1], c = state[2], d = state[3], x[16];
-  decode (x, block, blocksize);
- 
-  /* Round 1 */
-  FF (a, b, c, d, x[ 0], S11, 0xd76aa478); /* 1 */
-  FF (d, a, b, c, x[ 1], S12, 0xe8c7b756); /* 2 */
-  FF (c, d, a, b, x[ 2], S13, 0x242070db); /* 3 */
-  FF (b, c, d, a, x[ 3], S14, 0xc1bdceee); /* 4 */
-  FF (a, b, c, d, x[ 4], S11, 0xf57c0faf); /* 5 */
-  FF (d, a, b, c, x[ 5], S12, 0x4787c62a); /* 6 */
-  FF (c, d, a, b, x[ 6], S13, 0xa8304613); /* 7 */
-  FF (b, c, d, a, x[ 7], S14, 0xfd469501); /* 8 */
-  FF (a, b, c, d, x[ 8], S11, 0x698098d8); /* 9 */
-  FF (d, a, b, c, x[ 9], S12, 0x8b44f7af); /* 10 */
-  FF (c, d, a, b, x[10], S13, 0xffff5bb1); /* 11 */
-  FF (b, c, d, a, x[11], S14, 0x895cd7be); /* 12 */
-  FF (a, b, c, d, x[12], S11, 0x6b901122); /* 13 */
-  FF (d, a, b, c, x[13], S12, 0xfd987193); /* 14 */
-  FF (c, d, a, b, x[14], S13, 0xa679438e); /* 15 */
-  FF (b, c, d, a, x[15], S14, 0x49b40821); /* 16 */
- 
-  /* Round 2 */
-  GG (a, b, c, d, x[ 1], S21, 0xf61e2562); /* 17 */
-  GG (d, a, b, c, x[ 6], S22, 0xc040b340); /* 18 */
-  GG (c, d, a, b, x[11], S23, 0x265e5a51); /* 19 */
-  GG (b, c, d, a, x[ 0], S24, 0xe9b6c7aa); /* 20 */
-  GG (a, b, c, d, x[ 5], S21, 0xd62f105d); /* 21 */
-  GG (d, a, b, c, x[10], S22,  0x2441453); /* 22 */
-  GG (c, d, a, b, x[15], S23, 0xd8a1e681); /* 23 */
-  GG (b, c, d, a, x[ 4], S24, 0xe7d3fbc8); /* 24 */
-  GG (a, b, c, d, x[ 9], S21, 0x21e1cde6); /* 25 */
-  GG (d, a, b, c, x[14], S22, 0xc33707d6); /* 26 */
-  GG (c, d, a, b, x[ 3], S23, 0xf4d50d87); /* 27 */
-  GG (b, c, d, a, x[ 8], S24, 0x455a14ed); /* 28 */
-  GG (a, b, c, d, x[13], S21, 0xa9e3e905); /* 29 */
-  GG (d, a, b, c, x[ 2], S22, 0xfcefa3f8); /* 30 */
-  GG (c, d, a, b, x[ 7], S23, 0x676f02d9); /* 31 */
-  GG (b, c, d, a, x[12], S24, 0x8d2a4c8a); /* 32 */
- 
-  /* Round 3 */
-  HH (a, b, c, d, x[ 5], S31, 0xfffa3942); /* 33 */
-  HH (d, a, b, c, x[ 8], S32, 0x8771f681); /* 34 */
-  HH (c, d, a, b, x[11], S33, 0x6d9d6122); /* 35 */
-  HH (b, c, d, a, x[14], S34, 0xfde5380c); /* 36 */
-  HH (a, b, c, d, x[ 1], S31, 0xa4beea44); /* 37 */
-  HH (d, a, b, c, x[ 4], S32, 0x4bdecfa9); /* 38 */
-  HH (c, d, a, b, x[ 7], S33, 0xf6bb4b60); /* 39 */
-  HH (b, c, d, a, x[10], S34, 0xbebfbc70); /* 40 */
-  HH (a, b, c, d, x[13], S31, 0x289b7ec6); /* 41 */
-  HH (d, a, b, c, x[ 0], S32, 0xeaa127fa); /* 42 */
-  HH (c, d, a, b, x[ 3], S33, 0xd4ef3085); /* 43 */
-  HH (b, c, d, a, x[ 6], S34,  0x4881d05); /* 44 */
-  HH (a, b, c, d, x[ 9], S31, 0xd9d4d039); /* 45 */
-  HH (d, a, b, c, x[12], S32, 0xe6db99e5); /* 46 */
-  HH (c, d, a, b, x[15], S33, 0x1fa27cf8); /* 47 */
-  HH (b, c, d, a, x[ 2], S34, 0xc4ac5665); /* 48 */
- 
-  /* Round 4 */
-  II (a, b, c, d, x[ 0], S41, 0xf4292244); /* 49 */
-  II (d, a, b, c, x[ 7], S42, 0x432aff97); /* 50 */
-  II (c, d, a, b, x[14], S43, 0xab9423a7); /* 51 */
-  II (b, c, d, a, x[ 5], S44, 0xfc93a039); /* 52 */
-  II (a, b, c, d, x[12], S41, 0x655b59c3); /* 53 */
-  II (d, a, b, c, x[ 3], S42, 0x8f0ccc92); /* 54 */
-  II (c, d, a, b, x[10], S43, 0xffeff47d); /* 55 */
-  II (b, c, d, a, x[ 1], S44, 0x85845dd1); /* 56 */
-  II (a, b, c, d, x[ 8], S41, 0x6fa87e4f); /* 57 */
-  II (d, a, b, c, x[15], S42, 0xfe2ce6e0); /* 58 */
-  II (c, d, a, b, x[ 6], S43, 0xa3014314); /* 59 */
-  II (b, c, d, a, x[13], S44, 0x4e0811a1); /* 60 */
-  II (a, b, c, d, x[ 4], S41, 0xf7537e82); /* 61 */
-  II (d, a, b, c, x[11], S42, 0xbd3af235); /* 62 */
-  II (c, d, a, b, x[ 2], S43, 0x2ad7d2bb); /* 63 */
-  II (b, c, d, a, x[ 9], S44, 0xeb86d391); /* 64 */
- 
-  state[0] += a;
-  state[1] += b;
-  state[2] += c;
-  state[3] += d;
- 
-  // Zeroize sensitive information.
-  memset(x, 0, sizeof x);
+// apply MD5 algo on count consecutive blocks, loading the words straight
+// from the input and running the 64 steps fully unrolled
+void MD5::transform(uint4 state[4], const uint1 *blocks, size_type count)
+{
+  for (; count; count--, blocks += blocksize) {
+    uint4 x[16], v[4] = { state[0], state[1], state[2], state[3] };
+    for (int i = 0; i < 16; i++)
+      x[i] = load_le32(blocks + 4*i);
+ 
+    md5_lanes::steps<Scalar>(v, x, std::make_index_sequence<64>());
+ 
+    state[0] += v[0];
+    state[1] += v[1];
+    state[2] += v[2];
+    state[3] += v[3];
+  }
 }
  
 //////////////////////////////
@@ -254,33 +279,33 @@ void MD5::transform(const uint1 block[blocksize])
 void MD5::update(const unsigned char input[], size_type length)
 {
   // compute number of bytes mod 64
-  size_type index = count[0] / 8 % blocksize;
+  size_type index = count % blocksize;
  
-  // Update number of bits
-  if ((count[0] += (length << 3)) < (length << 3))
-    count[1]++;
-  count[1] += (length >> 29);
+  // Update number of bytes
+  count += length;
  
   // number of bytes we need to fill in buffer
-  size_type firstpart = 64 - index;
+  size_type firstpart = blocksize - index;
  
-  size_type i;
+  size_type i = 0;
  
   // transform as many times as possible.
   if (length >= firstpart)
   {
-    // fill buffer first, transform
-    memcpy(&buffer[index], input, firstpart);
-    transform(buffer);
- 
-    // transform chunks of blocksize (64 bytes)
-    for (i = firstpart; i + blocksize <= length; i += blocksize)
-      transform(&input[i]);
+    // complete the buffered block first, transform
+    if (index) {
+      memcpy(&buffer[index], input, firstpart);
+      transform(state, buffer, 1);
+      i = firstpart;
+    }
+ 
+    // transform chunks of blocksize (64 bytes) in place
+    size_type blocks = (length - i) / blocksize;
+    transform(state, &input[i], blocks);
+    i += blocks * blocksize;
  
     index = 0;
   }
-  else
-    i = 0;
  
   // buffer remaining input
   memcpy(&buffer[index], &input[i], length-i);
@@ -300,31 +325,31 @@ void MD5::update(const char input[], size_type length)
 // the message digest and zeroizing the context.
 MD5& MD5::finalize()
 {
-  static unsigned char padding[64] = {
-    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-  };
- 
   if (!finalized) {
     // Save number of bits
-    unsigned char bits[8];
-    encode(bits, count, 8);
+    std::uint64_t bits = count << 3;
  
     // pad out to 56 mod 64.
-    size_type index = count[0] / 8 % 64;
-    size_type padLen = (index < 56) ? (56 - index) : (120 - index);
-    update(padding, padLen);
+    size_type index = count % blocksize;
+    buffer[index++] = 0x80;
+    if (index > 56) {
+      memset(&buffer[index], 0, blocksize - index);
+      transform(state, buffer, 1);
+      index = 0;
+    }
+    memset(&buffer[index], 0, 56 - index);
  
     // Append length (before padding)
-    update(bits, 8);
+    for (int i = 0; i < 8; i++)
+      buffer[56+i] = static_cast<uint1>(bits >> (8*i));
+    transform(state, buffer, 1);
  
     // Store state in digest
     encode(digest, state, 16);
  
     // Zeroize sensitive information.
     memset(buffer, 0, sizeof buffer);
-    memset(count, 0, sizeof count);
+    count = 0;
  
     finalized=true;
   }
@@ -334,18 +359,51 @@ MD5& MD5::finalize()
  
 //////////////////////////////
  
+// one-shot MD5 of a whole buffer: the full blocks are hashed in place and
+// only the padded tail is copied, with no MD5 object involved
+void MD5::oneshot(const uint1 *input, size_type length, uint1 digest[16])
+{
+  uint4 state[4] = { MD5Constants::IV[0], MD5Constants::IV[1], MD5Constants::IV[2], MD5Constants::IV[3] };
+  size_type full = length / blocksize;
+  transform(state, input, full);
+ 
+  uint1 tail[2*blocksize] = {};
+  size_type rest = length % blocksize;
+  memcpy(tail, input + full*blocksize, rest);
+  tail[rest] = 0x80;
+  size_type blocks = (rest < 56) ? 1 : 2;
+  std::uint64_t bits = static_cast<std::uint64_t>(length) << 3;
+  for (int i = 0; i < 8; i++)
+    tail[blocks*blocksize - 8 + i] = static_cast<uint1>(bits >> (8*i));
+  transform(state, tail, blocks);
+ 
+  encode(digest, state, 16);
+}
+ 
+//////////////////////////////
+ 
 // return hex representation of digest as string
 std::string MD5::hexdigest() const
 {
   if (!finalized)
     return "";
  
-  char buf[33];
-  for (int i=0; i<16; i++)
-    sprintf(buf+i*2, "%02x", digest[i]);
-  buf[32]=0;
+  char buf[32];
+  to_hex(digest, buf);
+ 
+  return std::string(buf, sizeof buf);
+}
+ 
+//////////////////////////////
+ 
+// return the binary digest, all zeros if not finalized
+MD5::Digest MD5::binarydigest() const
+{
+  Digest result{};
+  if (finalized)
+    memcpy(result.data(), digest, sizeof digest);
  
-  return std::string(buf);
+  return result;
 }
  
 //////////////////////////////
@@ -357,12 +415,109 @@ std::ostream& operator<<(std::ostream& out, MD5 md5)
  
 //////////////////////////////
  
-std::string md5(const std::string str)
+std::ostream& operator<<(std::ostream& out, const MD5::Digest& digest)
+{
+  char buf[32];
+  to_hex(digest.data(), buf);
+ 
+  return out.write(buf, sizeof buf);
+}
+ 
+//////////////////////////////
+ 
+std::string md5(const std::string& str)
+{
+  return md5(str.data(), str.size());
+}
+ 
+//////////////////////////////
+ 
+std::string md5(const char *text, std::size_t length)
+{
+  unsigned char digest[16];
+  MD5::oneshot(reinterpret_cast<const unsigned char *>(text), length, digest);
+ 
+  char buf[32];
+  to_hex(digest, buf);
+ 
+  return std::string(buf, sizeof buf);
+}
+ 
+//////////////////////////////
+ 
+MD5::Digest md5_digest(const char *text, std::size_t length)
 {
-    MD5 md5 = MD5(str);
+  MD5::Digest digest;
+  MD5::oneshot(reinterpret_cast<const unsigned char *>(text), length, digest.data());
+ 
+  return digest;
+}
+ 
+//////////////////////////////
  
-    return md5.hexdigest();
+void md5_hex(const MD5::Digest& digest, char hex[32])
+{
+  to_hex(digest.data(), hex);
+}
+ 
+//////////////////////////////
+ 
+void md5_many(const std::string_view texts[], MD5::Digest digests[], std::size_t count)
+{
+  // the lanes of a kernel are wasted on small batches: below 2 messages the scalar code is faster
+  md5_kernels::batch_kernel batch = bound().load(std::memory_order_relaxed)->batch;
+  if (batch && count > 1) {
+    batch(texts, digests, count);
+    return;
+  }
+  // portable scalar fallback
+  for (std::size_t i = 0; i < count; i++)
+    MD5::oneshot(reinterpret_cast<const unsigned char *>(texts[i].data()), texts[i].size(), digests[i].data());
+}
+ 
+//////////////////////////////
+ 
+MD5Kernel md5_kernel()
+{
+  return bound().load(std::memory_order_relaxed)->kernel;
+}
+ 
+//////////////////////////////
+ 
+bool md5_select(MD5Kernel kernel)
+{
+  const Binding &binding = bindings()[static_cast<int>(kernel)];
+  if (!supported(binding))
+    return false;
+  bound().store(&binding, std::memory_order_relaxed);
+  return true;
+}
+ 
+//////////////////////////////
+ 
+const char *md5_kernel_name(MD5Kernel kernel)
+{
+  return bindings()[static_cast<int>(kernel)].name;
+}
+ 
+//////////////////////////////
+ 
+unsigned int md5_kernel_lanes(MD5Kernel kernel)
+{
+  return bindings()[static_cast<int>(kernel)].lanes;
+}
+ 
+//////////////////////////////
+ 
+bool md5_kernel_from_name(std::string_view name, MD5Kernel &kernel)
+{
+  for (int i = 0; i < kernels; i++) {
+    if (name == bindings()[i].name) {
+      kernel = bindings()[i].kernel;
+      return true;
+    }
+  }
+  return false;
 }
 
 } // namespace lcr
-
@@ -34,13 +34,16 @@ documentation and/or software.
 #define BZF_MD5_H
  
 #include <cstring>
+#include <cstdint>
 #include <iostream>
+#include <array>
+#include <string_view>
  
 namespace lcr
 {
  
 // a small class for calculating MD5 hashes of strings or byte arrays
-// it is not meant to be fast or secure
+// it is not meant to be secure
 //
 // usage: 1) feed it blocks of uchars with update()
 //      2) finalize()
@@ -52,47 +55,68 @@ namespace lcr
 class MD5
 {
 public:
-  typedef unsigned int size_type; // must be 32bit
+  typedef std::size_t size_type; // lengths of any size (the message length is kept in 64 bits)
+  struct Digest : std::array<std::uint8_t, 16> {}; // binary digest, printed in hex by operator<<
+  struct Midstate { std::uint32_t state[4]; std::uint64_t count; }; // state between two blocks
  
   MD5();
   MD5(const std::string& text);
+  MD5(const Midstate& midstate); // resumes hashing after a prefix
+  Midstate midstate() const; // only valid when the bytes hashed so far are a multiple of 64
   void update(const unsigned char *buf, size_type length);
   void update(const char *buf, size_type length);
   MD5& finalize();
   std::string hexdigest() const;
+  Digest binarydigest() const;
   friend std::ostream& operator<<(std::ostream&, MD5 md5);
+  friend std::string md5(const char *text, std::size_t length);
+  friend Digest md5_digest(const char *text, std::size_t length);
+  friend void md5_many(const std::string_view texts[], Digest digests[], std::size_t count);
  
 private:
   void init();
   typedef unsigned char uint1; //  8bit
-  typedef unsigned int uint4;  // 32bit
+  typedef std::uint32_t uint4; // 32bit
   enum {blocksize = 64}; // VC6 won't eat a const static int here
  
-  void transform(const uint1 block[blocksize]);
-  static void decode(uint4 output[], const uint1 input[], size_type len);
+  static void transform(uint4 state[4], const uint1 *blocks, size_type count);
+  static void oneshot(const uint1 *input, size_type length, uint1 digest[16]);
   static void encode(uint1 output[], const uint4 input[], size_type len);
  
   bool finalized;
   uint1 buffer[blocksize]; // bytes that didn't fit in last 64 byte chunk
-  uint4 count[2];   // 64bit counter for number of bits (lo, hi)
+  std::uint64_t count;     // 64bit counter for number of bytes
   uint4 state[4];   // digest so far
   uint1 digest[16]; // the result
- 
-  // low level logic operations
-  static inline uint4 F(uint4 x, uint4 y, uint4 z);
-  static inline uint4 G(uint4 x, uint4 y, uint4 z);
-  static inline uint4 H(uint4 x, uint4 y, uint4 z);
-  static inline uint4 I(uint4 x, uint4 y, uint4 z);
-  static inline uint4 rotate_left(uint4 x, int n);
-  static inline void FF(uint4 &a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac);
-  static inline void GG(uint4 &a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac);
-  static inline void HH(uint4 &a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac);
-  static inline void II(uint4 &a, uint4 b, uint4 c, uint4 d, uint4 x, uint4 s, uint4 ac);
 };
  
-std::string md5(const std::string str);
+std::ostream& operator<<(std::ostream&, const MD5::Digest& digest);
+ 
+std::string md5(const std::string& str);
+std::string md5(const char *text, std::size_t length);
+MD5::Digest md5_digest(const char *text, std::size_t length);
+
+// writes the 32 hex chars of the digest into the caller buffer (no null terminator)
+void md5_hex(const MD5::Digest& digest, char hex[32]);
+
+// batch version: hashes count independent texts, in parallel lanes when the CPU has SIMD
+// support (AVX-512: 16 lanes, AVX2: 8 lanes, SSE2: 4 lanes), one by one otherwise
+void md5_many(const std::string_view texts[], MD5::Digest digests[], std::size_t count);
+
+// kernels that md5_many can be bound to
+enum class MD5Kernel { scalar, sse2, avx2, avx512 };
+
+// the best kernel supported by the CPU is bound once, on first use; the LCR_MD5_KERNEL
+// environment variable (scalar, sse2, avx2 or avx512) overrides the choice for testing.
+// A single message is a serial chain of dependent steps, so md5() always runs the scalar code
+MD5Kernel md5_kernel();
+// binds the kernel to md5_many, returns false (and keeps the current one) if it is not supported
+bool md5_select(MD5Kernel kernel);
+const char *md5_kernel_name(MD5Kernel kernel);
+// number of messages that the kernel hashes at once
+unsigned int md5_kernel_lanes(MD5Kernel kernel);
+bool md5_kernel_from_name(std::string_view name, MD5Kernel &kernel);
 
 } // namespace lcr
  
 #endif
-
@@ -0,0 +1,53 @@
+//------------------------------------------------------------------------------------------
+//  File:        lcr/md5_avx2.cpp
+//
+//  Desc:        Multi-buffer MD5 kernel for AVX2: 8 lanes
+//
+//------------------------------------------------------------------------------------------
+#include "md5_kernels.h"
+
+#ifdef __AVX2__
+
+// Intrinsics
+#include <immintrin.h>
+
+// lib locar
+#include "md5_lanes.hpp"
+
+
+namespace
+{
+
+// Vector operations on 8 lanes of 32 bits
+struct AVX2
+{
+   typedef __m256i type;
+   static constexpr unsigned int lanes = 8;
+
+   static inline type load(const std::uint32_t * p) { return _mm256_load_si256(reinterpret_cast<const __m256i *>(p)); }
+   static inline void store(std::uint32_t * p, type a) { _mm256_store_si256(reinterpret_cast<__m256i *>(p), a); }
+   static inline type set1(std::uint32_t a) { return _mm256_set1_epi32(static_cast<int>(a)); }
+   static inline type add(type a, type b) { return _mm256_add_epi32(a, b); }
+   template <unsigned int S>
+   static inline type rotl(type a) { return _mm256_or_si256(_mm256_slli_epi32(a, S), _mm256_srli_epi32(a, 32 - S)); }
+
+   static inline type f(type b, type c, type d) { return _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d))); }
+   static inline type g(type b, type c, type d) { return _mm256_xor_si256(c, _mm256_and_si256(d, _mm256_xor_si256(b, c))); }
+   static inline type h(type b, type c, type d) { return _mm256_xor_si256(_mm256_xor_si256(b, c), d); }
+   static inline type i(type b, type c, type d) { return _mm256_xor_si256(c, _mm256_or_si256(b, _mm256_xor_si256(d, _mm256_set1_epi32(-1)))); }
+};
+
+void hash(const std::string_view texts[], lcr::MD5::Digest digests[], std::size_t count)
+{
+   lcr::md5_lanes::hash<AVX2>(texts, digests, count);
+}
+
+} // namespace
+
+const lcr::md5_kernels::batch_kernel lcr::md5_kernels::avx2 = &hash;
+
+#else
+
+const lcr::md5_kernels::batch_kernel lcr::md5_kernels::avx2 = nullptr;
+
+#endif // __AVX2__
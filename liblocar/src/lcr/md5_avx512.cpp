@@ -0,0 +1,53 @@
+//------------------------------------------------------------------------------------------
+//  File:        lcr/md5_avx512.cpp
+//
+//  Desc:        Multi-buffer MD5 kernel for AVX-512: 16 lanes
+//
+//------------------------------------------------------------------------------------------
+#include "md5_kernels.h"
+
+#ifdef __AVX512F__
+
+// Intrinsics
+#include <immintrin.h>
+
+// lib locar
+#include "md5_lanes.hpp"
+
+
+namespace
+{
+
+// Vector operations on 16 lanes of 32 bits: native rotations and ternary logic for the round functions
+struct AVX512
+{
+   typedef __m512i type;
+   static constexpr unsigned int lanes = 16;
+
+   static inline type load(const std::uint32_t * p) { return _mm512_load_si512(p); }
+   static inline void store(std::uint32_t * p, type a) { _mm512_store_si512(p, a); }
+   static inline type set1(std::uint32_t a) { return _mm512_set1_epi32(static_cast<int>(a)); }
+   static inline type add(type a, type b) { return _mm512_add_epi32(a, b); }
+   template <unsigned int S>
+   static inline type rotl(type a) { return _mm512_rol_epi32(a, S); }
+
+   static inline type f(type b, type c, type d) { return _mm512_ternarylogic_epi32(b, c, d, 0xca); } // b ? c : d
+   static inline type g(type b, type c, type d) { return _mm512_ternarylogic_epi32(d, b, c, 0xca); } // d ? b : c
+   static inline type h(type b, type c, type d) { return _mm512_ternarylogic_epi32(b, c, d, 0x96); } // b ^ c ^ d
+   static inline type i(type b, type c, type d) { return _mm512_ternarylogic_epi32(b, c, d, 0x39); } // c ^ (b | ~d)
+};
+
+void hash(const std::string_view texts[], lcr::MD5::Digest digests[], std::size_t count)
+{
+   lcr::md5_lanes::hash<AVX512>(texts, digests, count);
+}
+
+} // namespace
+
+const lcr::md5_kernels::batch_kernel lcr::md5_kernels::avx512 = &hash;
+
+#else
+
+const lcr::md5_kernels::batch_kernel lcr::md5_kernels::avx512 = nullptr;
+
+#endif // __AVX512F__
@@ -0,0 +1,120 @@
+//---------------------------------------------------------------------------
+//  File:        lcr/md5_constexpr.hpp
+//
+//  Desc:        MD5 evaluated at compile time (C++17 constexpr rules), for fixed keys, protocol constants
+//               and test vectors. It uses the constants of the runtime kernels, so they cannot drift.
+//               At run time it is a plain, slow scalar loop: use md5_digest() for runtime data.
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_md5_constexpr__HPP_
+#define LIB__lcr_md5_constexpr__HPP_
+
+
+// Stl
+#include <cstdint>
+#include <string_view>
+
+// lib locar
+#include "md5.h"
+#include "md5_constants.hpp"
+
+
+namespace lcr
+{
+   namespace md5_constexpr_detail
+   {
+
+   // Byte i of the padded message: the text, the 0x80 marker, zeros and the length in bits (little endian)
+   constexpr std::uint8_t padded_byte(std::string_view text, std::size_t total, std::size_t i)
+   {
+      if(i < text.size()) {
+         return static_cast<std::uint8_t>(text[i]);
+      }
+      if(i == text.size()) {
+         return 0x80;
+      }
+      if(i < total - 8) {
+         return 0;
+      }
+      return static_cast<std::uint8_t>((static_cast<std::uint64_t>(text.size()) << 3) >> (8 * (i - (total - 8))));
+   }
+
+   constexpr std::uint32_t rotl(std::uint32_t x, unsigned int n)
+   {
+      return (x << n) | (x >> (32 - n));
+   }
+
+   } // namespace md5_constexpr_detail
+
+
+// Function that returns the MD5 digest of a text; usable in constant expressions:
+//    constexpr MD5::Digest C_S_KEY = md5_constexpr("test1");
+constexpr MD5::Digest md5_constexpr(std::string_view text)
+{
+   using namespace md5_constexpr_detail;
+   const std::size_t total = (text.size() + 8) / 64 * 64 + 64; // Room for the marker and the length
+   std::uint32_t state[4] = { MD5Constants::IV[0], MD5Constants::IV[1], MD5Constants::IV[2], MD5Constants::IV[3] };
+
+   for(std::size_t block=0; block<total; block+=64) {
+      std::uint32_t x[16] = {};
+      for(std::size_t j=0; j<16; ++j) {
+         for(std::size_t b=0; b<4; ++b) {
+            x[j] |= static_cast<std::uint32_t>(padded_byte(text, total, block + 4 * j + b)) << (8 * b);
+         }
+      }
+      std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+      for(std::size_t i=0; i<64; ++i) {
+         std::uint32_t f = 0;
+         if(i < 16) {
+            f = (b & c) | (~b & d);
+         }
+         else if(i < 32) {
+            f = (b & d) | (c & ~d);
+         }
+         else if(i < 48) {
+            f = b ^ c ^ d;
+         }
+         else {
+            f = c ^ (b | ~d);
+         }
+         f += a + MD5Constants::K[i] + x[MD5Constants::X[i]];
+         a = d;
+         d = c;
+         c = b;
+         b += rotl(f, MD5Constants::S[i]);
+      }
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+   }
+
+   MD5::Digest digest{};
+   for(std::size_t i=0; i<4; ++i) {
+      for(std::size_t j=0; j<4; ++j) {
+         digest[4 * i + j] = static_cast<std::uint8_t>(state[i] >> (8 * j));
+      }
+   }
+   return digest;
+}
+
+// Function that compares a digest with its hex representation; usable in constant expressions,
+// so the runtime results can be checked against compile-time ones in static_asserts
+constexpr bool md5_equals(const MD5::Digest& digest, std::string_view hex)
+{
+   constexpr char C_S_HEX[] = "0123456789abcdef";
+   if(hex.size() != 2 * digest.size()) {
+      return false;
+   }
+   for(std::size_t i=0; i<digest.size(); ++i) {
+      if(hex[2 * i] != C_S_HEX[digest[i] >> 4] || hex[2 * i + 1] != C_S_HEX[digest[i] & 0x0f]) {
+         return false;
+      }
+   }
+   return true;
+}
+
+} // namespace lcr
+
+#endif // LIB__lcr_md5_constexpr__HPP_
@@ -0,0 +1,36 @@
+//---------------------------------------------------------------------------
+//  File:        lcr/md5_kernels.h
+//
+//  Desc:        Entry points of the multi-buffer MD5 kernels. Each kernel lives in its own translation
+//               unit built with the flags of its instruction set; it is null when the kernel has not
+//               been compiled in (e.g. on non x86 targets). Not a public header.
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_md5_kernels__H_
+#define LIB__lcr_md5_kernels__H_
+
+// Stl
+#include <cstddef>
+#include <string_view>
+
+// lib locar
+#include "md5.h"
+
+
+namespace lcr
+{
+   namespace md5_kernels
+   {
+
+   // Type of the batch kernels: hashes count texts, writing the digests at the same positions
+   typedef void (*batch_kernel)(const std::string_view texts[], MD5::Digest digests[], std::size_t count);
+
+   extern const batch_kernel sse2;    // 4 lanes
+   extern const batch_kernel avx2;    // 8 lanes
+   extern const batch_kernel avx512;  // 16 lanes
+
+   } // namespace md5_kernels
+} // namespace lcr
+
+#endif // LIB__lcr_md5_kernels__H_
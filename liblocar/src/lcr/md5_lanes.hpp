@@ -0,0 +1,169 @@
+//---------------------------------------------------------------------------
+//  File:        lcr/md5_lanes.hpp
+//
+//  Desc:        Multi-buffer MD5 kernel: hashes independent messages in the lanes of a vector register.
+//               It is a template over the vector operations, included by one translation unit per
+//               instruction set, each one compiled with its own target flags. Not a public header.
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_md5_lanes__HPP_
+#define LIB__lcr_md5_lanes__HPP_
+
+
+// Stl
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <string_view>
+
+// lib locar
+#include "md5.h"
+#include "md5_constants.hpp"
+
+
+namespace lcr
+{
+   namespace md5_lanes
+   {
+
+   // One MD5 step on all the lanes. The role of the state words rotates every step: (a,b,c,d), (d,a,b,c), (c,d,a,b), (b,c,d,a)
+   template <class V, std::size_t I>
+   inline void step(typename V::type (&v)[4], const typename V::type (&x)[16])
+   {
+      constexpr std::size_t t = (4 - I % 4) % 4;
+      typename V::type& a = v[t];
+      const typename V::type b = v[(t + 1) % 4], c = v[(t + 2) % 4], d = v[(t + 3) % 4];
+      typename V::type f;
+      if constexpr (I < 16) {
+         f = V::f(b, c, d);
+      }
+      else if constexpr (I < 32) {
+         f = V::g(b, c, d);
+      }
+      else if constexpr (I < 48) {
+         f = V::h(b, c, d);
+      }
+      else {
+         f = V::i(b, c, d);
+      }
+      f = V::add(V::add(a, f), V::add(x[MD5Constants::X[I]], V::set1(MD5Constants::K[I])));
+      a = V::add(b, V::template rotl<MD5Constants::S[I]>(f));
+   }
+
+   // The 64 steps, fully unrolled
+   template <class V, std::size_t... I>
+   inline void steps(typename V::type (&v)[4], const typename V::type (&x)[16], std::index_sequence<I...>)
+   {
+      (step<V, I>(v, x), ...);
+   }
+
+
+   // Function that hashes the texts in groups of V::lanes messages. Each lane walks its own message block by block,
+   // and as soon as a lane finishes it is refilled with the next pending message, so lanes are not wasted on
+   // messages of different lengths.
+   template <class V>
+   void hash(const std::string_view texts[], MD5::Digest digests[], std::size_t count)
+   {
+      constexpr unsigned int W = V::lanes;
+
+      // The status of a lane: the full blocks are read in place, the padded tail from the lane buffer
+      struct Lane
+      {
+         const unsigned char * data;
+         std::size_t full;            // Number of full blocks in place
+         std::size_t total;           // Number of blocks including the padded tail
+         std::size_t index;           // Next block to hash
+         std::size_t message;         // Index of the message in the batch
+         bool active;
+         unsigned char tail[128];
+      };
+      static const unsigned char C_S_ZERO_BLOCK[64] = {};
+
+      Lane lanes[W];
+      alignas(64) std::uint32_t state[4][W];
+      alignas(64) std::uint32_t words[16][W];
+      std::size_t next = 0;
+      unsigned int active = 0;
+
+      // Assigns the next pending message to the lane, if any
+      auto assign = [&](unsigned int l) {
+         Lane& lane = lanes[l];
+         lane.active = (next < count);
+         if(!lane.active) {
+            return;
+         }
+         const std::string_view& text = texts[next];
+         std::size_t rest = text.size() % 64;
+         lane.data = reinterpret_cast<const unsigned char *>(text.data());
+         lane.full = text.size() / 64;
+         lane.total = lane.full + (rest < 56 ? 1 : 2);
+         lane.index = 0;
+         lane.message = next++;
+         std::memset(lane.tail, 0, sizeof(lane.tail));
+         if(rest) {
+            std::memcpy(lane.tail, lane.data + lane.full * 64, rest);
+         }
+         lane.tail[rest] = 0x80;
+         std::uint64_t bits = static_cast<std::uint64_t>(text.size()) << 3;
+         unsigned char * length = lane.tail + (lane.total - lane.full) * 64 - 8;
+         for(unsigned int ii=0; ii<8; ++ii) {
+            length[ii] = static_cast<unsigned char>(bits >> (8 * ii));
+         }
+         for(unsigned int ii=0; ii<4; ++ii) {
+            state[ii][l] = MD5Constants::IV[ii];
+         }
+         ++active;
+      };
+
+      for(unsigned int l=0; l<W; ++l) {
+         assign(l);
+      }
+      while(active) {
+         // Transpose the current block of every lane: words[j] holds the j-th word of all the lanes
+         for(unsigned int l=0; l<W; ++l) {
+            const Lane& lane = lanes[l];
+            const unsigned char * block = C_S_ZERO_BLOCK;
+            if(lane.active) {
+               block = (lane.index < lane.full) ? lane.data + lane.index * 64 : lane.tail + (lane.index - lane.full) * 64;
+            }
+            for(unsigned int j=0; j<16; ++j) {
+               std::uint32_t word;
+               std::memcpy(&word, block + 4 * j, 4); // Little endian host assumed, as in the scalar kernel
+               words[j][l] = word;
+            }
+         }
+
+         typename V::type x[16], v[4], initial[4];
+         for(unsigned int j=0; j<16; ++j) {
+            x[j] = V::load(words[j]);
+         }
+         for(unsigned int ii=0; ii<4; ++ii) {
+            initial[ii] = v[ii] = V::load(state[ii]);
+         }
+         steps<V>(v, x, std::make_index_sequence<64>());
+         for(unsigned int ii=0; ii<4; ++ii) {
+            V::store(state[ii], V::add(v[ii], initial[ii]));
+         }
+
+         // Advance the lanes, collecting the finished digests
+         for(unsigned int l=0; l<W; ++l) {
+            Lane& lane = lanes[l];
+            if(lane.active && ++lane.index == lane.total) {
+               unsigned char * digest = digests[lane.message].data();
+               for(unsigned int ii=0; ii<4; ++ii) {
+                  for(unsigned int jj=0; jj<4; ++jj) {
+                     digest[4 * ii + jj] = static_cast<unsigned char>(state[ii][l] >> (8 * jj));
+                  }
+               }
+               --active;
+               assign(l);
+            }
+         }
+      }
+   }
+
+   } // namespace md5_lanes
+} // namespace lcr
+
+#endif // LIB__lcr_md5_lanes__HPP_
@@ -0,0 +1,53 @@
+//------------------------------------------------------------------------------------------
+//  File:        lcr/md5_sse2.cpp
+//
+//  Desc:        Multi-buffer MD5 kernel for SSE2: 4 lanes
+//
+//------------------------------------------------------------------------------------------
+#include "md5_kernels.h"
+
+#ifdef __SSE2__
+
+// Intrinsics
+#include <immintrin.h>
+
+// lib locar
+#include "md5_lanes.hpp"
+
+
+namespace
+{
+
+// Vector operations on 4 lanes of 32 bits
+struct SSE2
+{
+   typedef __m128i type;
+   static constexpr unsigned int lanes = 4;
+
+   static inline type load(const std::uint32_t * p) { return _mm_load_si128(reinterpret_cast<const __m128i *>(p)); }
+   static inline void store(std::uint32_t * p, type a) { _mm_store_si128(reinterpret_cast<__m128i *>(p), a); }
+   static inline type set1(std::uint32_t a) { return _mm_set1_epi32(static_cast<int>(a)); }
+   static inline type add(type a, type b) { return _mm_add_epi32(a, b); }
+   template <unsigned int S>
+   static inline type rotl(type a) { return _mm_or_si128(_mm_slli_epi32(a, S), _mm_srli_epi32(a, 32 - S)); }
+
+   static inline type f(type b, type c, type d) { return _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d))); }
+   static inline type g(type b, type c, type d) { return _mm_xor_si128(c, _mm_and_si128(d, _mm_xor_si128(b, c))); }
+   static inline type h(type b, type c, type d) { return _mm_xor_si128(_mm_xor_si128(b, c), d); }
+   static inline type i(type b, type c, type d) { return _mm_xor_si128(c, _mm_or_si128(b, _mm_xor_si128(d, _mm_set1_epi32(-1)))); }
+};
+
+void hash(const std::string_view texts[], lcr::MD5::Digest digests[], std::size_t count)
+{
+   lcr::md5_lanes::hash<SSE2>(texts, digests, count);
+}
+
+} // namespace
+
+const lcr::md5_kernels::batch_kernel lcr::md5_kernels::sse2 = &hash;
+
+#else
+
+const lcr::md5_kernels::batch_kernel lcr::md5_kernels::sse2 = nullptr;
+
+#endif // __SSE2__
@@ -0,0 +1,315 @@
+//------------------------------------------------------------------------------------------
+//  File:        lcr/sha.cpp
+//
+//  Desc:        SHA-1 and SHA-256 one-shot digests, portable block functions and kernel binding
+//
+//------------------------------------------------------------------------------------------
+#include "sha.h"
+
+// Stl
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+// lib locar
+#include "sha_kernels.h"
+#include "sha_constants.hpp"
+
+
+namespace
+{
+
+inline std::uint32_t rotl(std::uint32_t x, unsigned int n)
+{
+   return (x << n) | (x >> (32 - n));
+}
+
+inline std::uint32_t rotr(std::uint32_t x, unsigned int n)
+{
+   return (x >> n) | (x << (32 - n));
+}
+
+// Unaligned big endian load of a 32 bit word
+inline std::uint32_t load_be32(const unsigned char * p)
+{
+   return (static_cast<std::uint32_t>(p[0]) << 24) | (static_cast<std::uint32_t>(p[1]) << 16) |
+          (static_cast<std::uint32_t>(p[2]) << 8) | static_cast<std::uint32_t>(p[3]);
+}
+
+// Portable SHA-1 block function
+void sha1_scalar(std::uint32_t state[5], const unsigned char * blocks, std::size_t count)
+{
+   using lcr::SHAConstants;
+   for(std::size_t block=0; block<count; ++block, blocks+=64) {
+      std::uint32_t w[80];
+      for(unsigned int t=0; t<16; ++t) {
+         w[t] = load_be32(blocks + 4 * t);
+      }
+      for(unsigned int t=16; t<80; ++t) {
+         w[t] = rotl(w[t-3] ^ w[t-8] ^ w[t-14] ^ w[t-16], 1);
+      }
+      std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+      // One loop per round, so the boolean function is not chosen at every step
+      auto step = [&](std::uint32_t f, std::uint32_t k, std::uint32_t word) {
+         std::uint32_t temp = rotl(a, 5) + f + e + k + word;
+         e = d;
+         d = c;
+         c = rotl(b, 30);
+         b = a;
+         a = temp;
+      };
+      for(unsigned int t=0; t<20; ++t) {
+         step(d ^ (b & (c ^ d)), SHAConstants::SHA1_K[0], w[t]);
+      }
+      for(unsigned int t=20; t<40; ++t) {
+         step(b ^ c ^ d, SHAConstants::SHA1_K[1], w[t]);
+      }
+      for(unsigned int t=40; t<60; ++t) {
+         step((b & c) | (d & (b | c)), SHAConstants::SHA1_K[2], w[t]);
+      }
+      for(unsigned int t=60; t<80; ++t) {
+         step(b ^ c ^ d, SHAConstants::SHA1_K[3], w[t]);
+      }
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+   }
+}
+
+// Portable SHA-256 block function
+void sha256_scalar(std::uint32_t state[8], const unsigned char * blocks, std::size_t count)
+{
+   using lcr::SHAConstants;
+   for(std::size_t block=0; block<count; ++block, blocks+=64) {
+      std::uint32_t w[64];
+      for(unsigned int t=0; t<16; ++t) {
+         w[t] = load_be32(blocks + 4 * t);
+      }
+      for(unsigned int t=16; t<64; ++t) {
+         std::uint32_t s0 = rotr(w[t-15], 7) ^ rotr(w[t-15], 18) ^ (w[t-15] >> 3);
+         std::uint32_t s1 = rotr(w[t-2], 17) ^ rotr(w[t-2], 19) ^ (w[t-2] >> 10);
+         w[t] = w[t-16] + s0 + w[t-7] + s1;
+      }
+      std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+      for(unsigned int t=0; t<64; ++t) {
+         std::uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + (g ^ (e & (f ^ g))) + SHAConstants::SHA256_K[t] + w[t];
+         std::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) | (c & (a | b)));
+         h = g;
+         g = f;
+         f = e;
+         e = d + t1;
+         d = c;
+         c = b;
+         b = a;
+         a = t1 + t2;
+      }
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+   }
+}
+
+// A kernel that the block functions can be bound to
+struct Binding
+{
+   lcr::SHAKernel kernel;
+   const char * name;
+   lcr::sha_kernels::sha1_blocks sha1;
+   lcr::sha_kernels::sha256_blocks sha256; // Both null when the kernel has not been compiled in
+};
+
+// The kernels, indexed by lcr::SHAKernel
+const Binding * bindings()
+{
+   static const Binding table[] = {
+      { lcr::SHAKernel::scalar, "scalar", &sha1_scalar, &sha256_scalar },
+      { lcr::SHAKernel::shani, "shani", lcr::sha_kernels::sha1_shani, lcr::sha_kernels::sha256_shani }
+   };
+   return table;
+}
+
+// True if the kernel has been compiled in and the CPU supports it
+bool supported(const Binding& binding)
+{
+   if(!binding.sha1 || !binding.sha256) {
+      return false;
+   }
+   if(binding.kernel == lcr::SHAKernel::shani) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_cpu_init(); // We may run before the static constructors
+      return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#else
+      return false;
+#endif
+   }
+   return true;
+}
+
+// The environment override if it is supported, the fastest supported kernel otherwise
+const Binding * detect()
+{
+   lcr::SHAKernel kernel;
+   const char * name = std::getenv("LCR_SHA_KERNEL");
+   if(name && lcr::sha_kernel_from_name(name, kernel) && supported(bindings()[static_cast<int>(kernel)])) {
+      return &bindings()[static_cast<int>(kernel)];
+   }
+   return supported(bindings()[1]) ? &bindings()[1] : &bindings()[0];
+}
+
+// The bound kernel
+std::atomic<const Binding *>& bound()
+{
+   static std::atomic<const Binding *> binding(detect());
+   return binding;
+}
+
+// Padding shared by both algorithms: hashes the last bytes of a text (less than a block) followed by the 0x80 marker,
+// zeros and the length of the text in bits, big endian, from a local buffer of one or two blocks, and writes the digest
+template <class BLOCKS, class STATE>
+void finish(BLOCKS blocks, STATE * state, const unsigned char * rest, std::size_t bytes, std::uint64_t length, std::uint8_t * digest, std::size_t size)
+{
+   unsigned char tail[128] = {};
+   std::size_t tail_blocks = (bytes < 56) ? 1 : 2;
+   std::memcpy(tail, rest, bytes);
+   tail[bytes] = 0x80;
+   std::uint64_t bits = length << 3;
+   for(unsigned int ii=0; ii<8; ++ii) {
+      tail[tail_blocks * 64 - 1 - ii] = static_cast<unsigned char>(bits >> (8 * ii));
+   }
+   blocks(state, tail, tail_blocks);
+
+   for(std::size_t ii=0; ii<size; ++ii) {
+      digest[ii] = static_cast<std::uint8_t>(state[ii / 4] >> (24 - 8 * (ii % 4)));
+   }
+}
+
+// Merkle-Damgard driver shared by both algorithms: the full blocks are hashed in place, then the padded tail
+template <class BLOCKS, std::size_t WORDS>
+void digest(BLOCKS blocks, std::uint32_t (&state)[WORDS], const char * text, std::size_t length, std::uint8_t * digest, std::size_t size)
+{
+   const unsigned char * data = reinterpret_cast<const unsigned char *>(text);
+   std::size_t full = length / 64, rest = length % 64;
+   blocks(state, data, full);
+   finish(blocks, state, data + full * 64, rest, length, digest, size);
+}
+
+} // namespace
+
+
+namespace lcr
+{
+
+SHA1Digest sha1_digest(const char * text, std::size_t length)
+{
+   std::uint32_t state[5];
+   std::memcpy(state, SHAConstants::SHA1_IV, sizeof(state));
+   SHA1Digest result;
+   digest(bound().load(std::memory_order_relaxed)->sha1, state, text, length, result.data(), result.size());
+   return result;
+}
+
+SHA256Digest sha256_digest(const char * text, std::size_t length)
+{
+   std::uint32_t state[8];
+   std::memcpy(state, SHAConstants::SHA256_IV, sizeof(state));
+   SHA256Digest result;
+   digest(bound().load(std::memory_order_relaxed)->sha256, state, text, length, result.data(), result.size());
+   return result;
+}
+
+SHAStream::SHAStream(Algorithm algorithm)
+   : algorithm_(algorithm)
+   , state_()
+   , block_()
+   , buffered_()
+   , length_()
+{
+   if(algorithm_==Algorithm::sha1) {
+      std::memcpy(state_, SHAConstants::SHA1_IV, 5 * sizeof(std::uint32_t));
+   }
+   else {
+      std::memcpy(state_, SHAConstants::SHA256_IV, 8 * sizeof(std::uint32_t));
+   }
+}
+
+void SHAStream::update(const char * text, std::size_t length)
+{
+   const Binding * binding = bound().load(std::memory_order_relaxed);
+   auto blocks = [this, binding](const unsigned char * data, std::size_t count) {
+      if(algorithm_==Algorithm::sha1) {
+         binding->sha1(state_, data, count);
+      }
+      else {
+         binding->sha256(state_, data, count);
+      }
+   };
+   const unsigned char * data = reinterpret_cast<const unsigned char *>(text);
+   length_ += length;
+   if(buffered_) { // Complete the pending block first
+      std::size_t bytes = std::min(length, 64 - buffered_);
+      std::memcpy(block_ + buffered_, data, bytes);
+      buffered_ += bytes;
+      data += bytes;
+      length -= bytes;
+      if(buffered_<64) {
+         return;
+      }
+      blocks(block_, 1);
+      buffered_ = 0;
+   }
+   blocks(data, length / 64); // The full blocks in place
+   buffered_ = length % 64;
+   std::memcpy(block_, data + length - buffered_, buffered_);
+}
+
+void SHAStream::finalize(std::uint8_t * digest)
+{
+   const Binding * binding = bound().load(std::memory_order_relaxed);
+   if(algorithm_==Algorithm::sha1) {
+      finish(binding->sha1, state_, block_, buffered_, length_, digest, 20);
+   }
+   else {
+      finish(binding->sha256, state_, block_, buffered_, length_, digest, 32);
+   }
+}
+
+SHAKernel sha_kernel()
+{
+   return bound().load(std::memory_order_relaxed)->kernel;
+}
+
+bool sha_select(SHAKernel kernel)
+{
+   const Binding& binding = bindings()[static_cast<int>(kernel)];
+   if(!supported(binding)) {
+      return false;
+   }
+   bound().store(&binding, std::memory_order_relaxed);
+   return true;
+}
+
+const char * sha_kernel_name(SHAKernel kernel)
+{
+   return bindings()[static_cast<int>(kernel)].name;
+}
+
+bool sha_kernel_from_name(std::string_view name, SHAKernel& kernel)
+{
+   for(int ii=0; ii<2; ++ii) {
+      if(name == bindings()[ii].name) {
+         kernel = bindings()[ii].kernel;
+         return true;
+      }
+   }
+   return false;
+}
+
+} // namespace lcr
@@ -0,0 +1,69 @@
+//---------------------------------------------------------------------------
+//  File:        lcr/sha.h
+//
+//  Desc:        SHA-1 and SHA-256 (FIPS 180-4) one-shot digests. The block functions are bound once
+//               at run time: the x86 SHA extensions when the CPU has them, portable code otherwise.
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_sha__H_
+#define LIB__lcr_sha__H_
+
+
+// Stl
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+
+namespace lcr
+{
+
+// Binary digests
+struct SHA1Digest : std::array<std::uint8_t, 20> {};
+struct SHA256Digest : std::array<std::uint8_t, 32> {};
+
+// Functions that return the digest of a text
+SHA1Digest sha1_digest(const char * text, std::size_t length);
+SHA256Digest sha256_digest(const char * text, std::size_t length);
+
+// Class that computes the digest of a text given in pieces, e.g. a file read in chunks
+class SHAStream
+{
+   public:
+      // The algorithms
+      enum class Algorithm { sha1, sha256 };
+
+   public:
+      // The constructor receives as parameter the algorithm
+      explicit SHAStream(Algorithm algorithm);
+
+   public:
+      // Method that adds the next piece of the text
+      void update(const char * text, std::size_t length);
+      // Method that writes the digest of the text: 20 bytes for SHA-1, 32 for SHA-256
+      void finalize(std::uint8_t * digest);
+
+   private:
+      Algorithm algorithm_;
+      std::uint32_t state_[8];
+      unsigned char block_[64];  // The bytes of the incomplete block
+      std::size_t buffered_;
+      std::uint64_t length_;     // The length of the text so far
+};
+
+// Kernels that the block functions can be bound to
+enum class SHAKernel { scalar, shani };
+
+// The best kernel supported by the CPU is bound on first use; the LCR_SHA_KERNEL environment
+// variable (scalar or shani) overrides the choice for testing
+SHAKernel sha_kernel();
+// Binds the kernel, returns false (and keeps the current one) if it is not supported
+bool sha_select(SHAKernel kernel);
+const char * sha_kernel_name(SHAKernel kernel);
+bool sha_kernel_from_name(std::string_view name, SHAKernel& kernel);
+
+} // namespace lcr
+
+#endif // LIB__lcr_sha__H_
@@ -0,0 +1,33 @@
+//---------------------------------------------------------------------------
+//  File:        lcr/sha_kernels.h
+//
+//  Desc:        Entry points of the SHA block functions that use the x86 SHA extensions. They live in
+//               their own translation unit built with the flags of the extensions; they are null when
+//               they have not been compiled in (e.g. on non x86 targets). Not a public header.
+//
+//---------------------------------------------------------------------------
+
+#ifndef LIB__lcr_sha_kernels__H_
+#define LIB__lcr_sha_kernels__H_
+
+// Stl
+#include <cstddef>
+#include <cstdint>
+
+
+namespace lcr
+{
+   namespace sha_kernels
+   {
+
+   // Types of the block functions: update the state with count blocks of 64 bytes
+   typedef void (*sha1_blocks)(std::uint32_t state[5], const unsigned char * blocks, std::size_t count);
+   typedef void (*sha256_blocks)(std::uint32_t state[8], const unsigned char * blocks, std::size_t count);
+
+   extern const sha1_blocks sha1_shani;
+   extern const sha256_blocks sha256_shani;
+
+   } // namespace sha_kernels
+} // namespace lcr
+
+#endif // LIB__lcr_sha_kernels__H_
@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------------------
+//  File:        lcr/sha_shani.cpp
+//
+//  Desc:        SHA-1 and SHA-256 block functions for the x86 SHA extensions. The message schedule
+//               is kept in four registers of four words that are reused as the rounds go by.
+//
+//------------------------------------------------------------------------------------------
+#include "sha_kernels.h"
+
+#if defined(__SHA__) && defined(__SSE4_1__)
+
+// Stl
+#include <utility>
+
+// Intrinsics
+#include <immintrin.h>
+
+// lib locar
+#include "sha_constants.hpp"
+
+
+namespace
+{
+
+// Four SHA-1 rounds (I from 0 to 19) with the message words of msg[I % 4]: the E value alternates between e[0] and e[1],
+// and the next message words are computed as soon as their inputs are available
+template <std::size_t I>
+inline void sha1_rounds(__m128i& abcd, __m128i (&e)[2], __m128i (&msg)[4])
+{
+   __m128i& current = e[I % 2];
+   if constexpr (I == 0) {
+      current = _mm_add_epi32(current, msg[0]);
+   }
+   else {
+      current = _mm_sha1nexte_epu32(current, msg[I % 4]);
+   }
+   e[(I + 1) % 2] = abcd;
+   if constexpr (I >= 3 && I <= 18) {
+      msg[(I + 1) % 4] = _mm_sha1msg2_epu32(msg[(I + 1) % 4], msg[I % 4]);
+   }
+   abcd = _mm_sha1rnds4_epu32(abcd, current, I / 5);
+   if constexpr (I >= 1 && I <= 16) {
+      msg[(I + 3) % 4] = _mm_sha1msg1_epu32(msg[(I + 3) % 4], msg[I % 4]);
+   }
+   if constexpr (I >= 2 && I <= 17) {
+      msg[(I + 2) % 4] = _mm_xor_si128(msg[(I + 2) % 4], msg[I % 4]);
+   }
+}
+
+template <std::size_t... I>
+inline void sha1_all_rounds(__m128i& abcd, __m128i (&e)[2], __m128i (&msg)[4], std::index_sequence<I...>)
+{
+   (sha1_rounds<I>(abcd, e, msg), ...);
+}
+
+void sha1(std::uint32_t state[5], const unsigned char * blocks, std::size_t count)
+{
+   const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL); // Big endian words, reversed
+   __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0x1b);
+   __m128i e[2] = { _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0), _mm_setzero_si128() };
+
+   for(std::size_t block=0; block<count; ++block, blocks+=64) {
+      const __m128i abcd_save = abcd, e_save = e[0];
+      __m128i msg[4];
+      for(unsigned int ii=0; ii<4; ++ii) {
+         msg[ii] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + 16 * ii)), mask);
+      }
+      sha1_all_rounds(abcd, e, msg, std::make_index_sequence<20>());
+      e[0] = _mm_sha1nexte_epu32(e[0], e_save);
+      abcd = _mm_add_epi32(abcd, abcd_save);
+   }
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_shuffle_epi32(abcd, 0x1b));
+   state[4] = static_cast<std::uint32_t>(_mm_extract_epi32(e[0], 3));
+}
+
+
+// Four SHA-256 rounds (I from 0 to 15) with the message words of msg[I % 4], computing the next message words
+// as soon as their inputs are available
+template <std::size_t I>
+inline void sha256_rounds(__m128i& abef, __m128i& cdgh, __m128i (&msg)[4])
+{
+   __m128i words = _mm_add_epi32(msg[I % 4], _mm_load_si128(reinterpret_cast<const __m128i *>(lcr::SHAConstants::SHA256_K + 4 * I)));
+   cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+   if constexpr (I >= 3 && I <= 14) {
+      __m128i& next = msg[(I + 1) % 4];
+      next = _mm_add_epi32(next, _mm_alignr_epi8(msg[I % 4], msg[(I + 3) % 4], 4));
+      next = _mm_sha256msg2_epu32(next, msg[I % 4]);
+   }
+   abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0e));
+   if constexpr (I >= 1 && I <= 12) {
+      msg[(I + 3) % 4] = _mm_sha256msg1_epu32(msg[(I + 3) % 4], msg[I % 4]);
+   }
+}
+
+template <std::size_t... I>
+inline void sha256_all_rounds(__m128i& abef, __m128i& cdgh, __m128i (&msg)[4], std::index_sequence<I...>)
+{
+   (sha256_rounds<I>(abef, cdgh, msg), ...);
+}
+
+void sha256(std::uint32_t state[8], const unsigned char * blocks, std::size_t count)
+{
+   const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL); // Big endian words
+   // The instructions keep the state as (A, B, E, F) and (C, D, G, H)
+   __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xb1);     // CDAB
+   __m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1b); // EFGH
+   __m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+   cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+   for(std::size_t block=0; block<count; ++block, blocks+=64) {
+      const __m128i abef_save = abef, cdgh_save = cdgh;
+      __m128i msg[4];
+      for(unsigned int ii=0; ii<4; ++ii) {
+         msg[ii] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + 16 * ii)), mask);
+      }
+      sha256_all_rounds(abef, cdgh, msg, std::make_index_sequence<16>());
+      abef = _mm_add_epi32(abef, abef_save);
+      cdgh = _mm_add_epi32(cdgh, cdgh_save);
+   }
+   tmp = _mm_shuffle_epi32(abef, 0x1b);                                                                    // FEBA
+   cdgh = _mm_shuffle_epi32(cdgh, 0xb1);                                                                   // DCHG
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(tmp, cdgh, 0xf0));                 // DCBA
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(cdgh, tmp, 8));                // HGFE
+}
+
+} // namespace
+
+const lcr::sha_kernels::sha1_blocks lcr::sha_kernels::sha1_shani = &sha1;
+const lcr::sha_kernels::sha256_blocks lcr::sha_kernels::sha256_shani = &sha256;
+
+#else
+
+const lcr::sha_kernels::sha1_blocks lcr::sha_kernels::sha1_shani = nullptr;
+const lcr::sha_kernels::sha256_blocks lcr::sha_kernels::sha256_shani = nullptr;
+
+#endif // __SHA__ && __SSE4_1__
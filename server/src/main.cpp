@@ -7,13 +7,21 @@
 #include <memory>
 #include <csignal>
 #include <string.h>
+#include <limits.h>
+#include <stdlib.h>
 
 // Components
 #include "ncs/Server.h"
+#include "ncs/MetricsServer.h"
 
 // lib locar
 #include "lcr/StdLogger.h"
+#include "lcr/AsyncLogger.h"
+#include "lcr/FileLogger.h"
+#include "lcr/BinaryLogger.h"
 #include "lcr/CommandLine.hpp"
+#include "lcr/md5.h"
+#include "lcr/sha.h"
 
 
 
@@ -22,14 +30,27 @@ struct Arguments // The Arguments type stores the parameters from the command li
 {
    int log_level{};      // The log level serves as threshold to decide which logger traces are displayed on the screen and which are not. Posible values: [1-6]
    int port{};           // The server port number. Posible values: [1024-65535]
+   int metrics_port{};   // The port number of the metrics, on the loopback address. When zero, the metrics are not served.
    int cache_capacity{}; // The max size for the internal cache
    int cache_timeout{};  // Timeout used to automatically discard entries from the cache based on their temporal age. When zero, the automatic discard is disabled.
+   int batch_deadline{}; // The deadline of the batches of texts hashed together, in microseconds. When zero, every text is hashed on its own.
+   int prefix_memory{};  // The memory for the MD5 states of common text prefixes, in kB. When zero, the prefix cache is disabled.
+   std::string files_root; // The root directory of the files that clients can hash with 'file' requests. When empty, file requests are disabled.
+   int log_rotate_size{-1}; // The size of the log file that starts a new one, in MB. When zero, the file is not rotated by size.
+   int log_rotate_age{};  // The age of the log file that starts a new one, in seconds. When zero, the file is not rotated by age.
+   std::string logger;     // The logger: std (written by the calling thread), async (written by a background thread, dropping the records
+                           // that do not fit in its ring), async-block (the same, but waiting for room in the ring), file and file-block
+                           // (the same, written to a rotated file) or binary (binary records in a memory mapped file, decoded offline by
+                           // ncs-logdecode)
+   std::string log_file;   // The file of the file and binary loggers
+   std::string md5_kernel; // The MD5 kernel used for batches, overriding the detected one. Posible values: [scalar, sse2, avx2, avx512]
 };
 
 
 // Prototypes //////////////////////////////////////////////////////////////////////
 void show_usage(); // Function that shows the program usage
 void check(Arguments& args); // Function that checks the arguments validity
+lcr::Logger& create_logger(const Arguments& args); // Function that creates the logger selected in the command line
 void signal_handler(int signum); // Function that handles all required signals
 std::string decode_return_code(int rc); // Function that decodes the program return code
 
@@ -38,9 +59,16 @@ std::string decode_return_code(int rc); // Function that decodes the program ret
 static const int C_S_DEFAULT_PORT = 3456;
 static const int C_S_DEFAULT_CACHE_CAPACITY = 10;
 static const int C_S_DEFAULT_CACHE_TIMEOUT = 600;
+static const int C_S_DEFAULT_LOG_ROTATE_SIZE = 64;
+static const char * C_S_DEFAULT_LOG_FILE = "server.log";
+static const char * C_S_DEFAULT_BINARY_LOG_FILE = "server.blog";
 
 // Static objects /////////////////////////////////////////////////////////////////
 static std::shared_ptr<ncs::Server> s_server_ptr;
+static std::unique_ptr<ncs::MetricsServer> s_metrics_ptr;
+static std::unique_ptr<lcr::AsyncLogger> s_async_logger_ptr;
+static std::unique_ptr<lcr::BinaryLogger> s_binary_logger_ptr;
+static lcr::Logger* s_logger_ptr = nullptr;
 static int s_log_level = 3;
 
 
@@ -57,20 +85,40 @@ int main(int argc, const char* argv[])
    auto args = lcr::CommandLine<Arguments>::Parser({
       {"-l", &Arguments::log_level},
       {"-p", &Arguments::port},
+      {"-M", &Arguments::metrics_port},
       {"-C", &Arguments::cache_capacity},
-      {"-t", &Arguments::cache_timeout}
+      {"-t", &Arguments::cache_timeout},
+      {"-r", &Arguments::files_root},
+      {"-m", &Arguments::prefix_memory},
+      {"-b", &Arguments::batch_deadline},
+      {"-k", &Arguments::md5_kernel},
+      {"-L", &Arguments::logger},
+      {"-o", &Arguments::log_file},
+      {"-S", &Arguments::log_rotate_size},
+      {"-A", &Arguments::log_rotate_age}
    })->parse(argc, argv);
 
    // Check the arguments validity
    check(args);
 
    // Get the logger reference after the command line argument has been applied
-   auto & logger = lcr::StdLogger::instance(s_log_level);
+   auto & logger = create_logger(args);
 
-   logger.trace(LOG_LEVEL_1, "[MAIN] Started!");
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Started!");
 
    // Instantiate the NCS server (NeCat Server)
-   s_server_ptr.reset(new ncs::Server(args.port, args.cache_capacity, args.cache_timeout, logger));
+   s_server_ptr.reset(new ncs::Server(args.port, args.cache_capacity, args.cache_timeout, args.files_root, args.prefix_memory * std::size_t(1024),
+                                        std::chrono::microseconds(args.batch_deadline), logger));
+
+   // Serve its statistics on the admin port
+   if(args.metrics_port) {
+      try {
+         s_metrics_ptr.reset(new ncs::MetricsServer(args.metrics_port, *s_server_ptr, logger));
+      }
+      catch(const lcr::RuntimeError& ex) {
+         logger.error(LOG_WARNING, "[MAIN] %s: %s. The metrics are disabled", ex.what(), strerror(ex.ec()));
+      }
+   }
 
    // Register our handler for the required signals 
    signal(SIGUSR1, signal_handler);
@@ -101,10 +149,16 @@ int main(int argc, const char* argv[])
       rc = -4;
    }
 
-   // Destroy the NCS server
+   // Destroy the NCS server, once nothing reads its statistics
+   s_metrics_ptr.reset();
    s_server_ptr.reset();
 
-   logger.trace(LOG_LEVEL_1, "[MAIN] %s!", decode_return_code(rc).c_str());
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] %s!", decode_return_code(rc).c_str());
+
+   // Write the pending records
+   s_logger_ptr = &lcr::StdLogger::instance(s_log_level);
+   s_async_logger_ptr.reset();
+   s_binary_logger_ptr.reset();
    return rc;
 }
 
@@ -124,6 +178,11 @@ void show_usage()
    std::cout << "         The server port number." << std::endl;
    std::cout << "         Posible values: [1024-65535]" << std::endl;
    std::cout << "         Default value: " << C_S_DEFAULT_PORT << std::endl << std::endl;
+   std::cout << " -M      Metrics port number" << std::endl;
+   std::cout << "         The port number where the statistics are served in the Prometheus text format (http://127.0.0.1:port/metrics)," << std::endl;
+   std::cout << "         on the loopback address only. When zero, the metrics are not served." << std::endl;
+   std::cout << "         Posible values: [1024-65535]" << std::endl;
+   std::cout << "         Default value: 0 (disabled)" << std::endl << std::endl;
    std::cout << " -C      Cache capacity" << std::endl;
    std::cout << "         The max size for the internal cache." << std::endl;
    std::cout << "         Default value: " << C_S_DEFAULT_CACHE_CAPACITY << " entries" << std::endl << std::endl;
@@ -131,6 +190,44 @@ void show_usage()
    std::cout << "         Timeout used to automatically discard entries from the cache based on their temporal age." << std::endl;
    std::cout << "         When zero, the automatic discard is disabled." << std::endl;
    std::cout << "         Default value: " << C_S_DEFAULT_CACHE_TIMEOUT << " seconds" << std::endl << std::endl;
+   std::cout << " -r      Files root directory" << std::endl;
+   std::cout << "         The directory of the files that clients can hash with 'file path n' requests. Paths are relative to it." << std::endl;
+   std::cout << "         Default value: none (file requests are disabled)" << std::endl << std::endl;
+   std::cout << " -m      MD5 prefix cache memory" << std::endl;
+   std::cout << "         The memory used to keep the MD5 state after the prefixes (in blocks of 64 bytes) of the texts already hashed," << std::endl;
+   std::cout << "         so texts sharing long prefixes do not hash them again. When zero, the prefix cache is disabled." << std::endl;
+   std::cout << "         Default value: 0 kB" << std::endl << std::endl;
+   std::cout << " -b      Hash batch deadline" << std::endl;
+   std::cout << "         The texts whose delay has expired are hashed together in the lanes of the MD5 kernel: a batch starts when it" << std::endl;
+   std::cout << "         is full, or this number of microseconds after its first text. When zero, every text is hashed on its own." << std::endl;
+   std::cout << "         The prefix cache (-m), when enabled, is used instead." << std::endl;
+   std::cout << "         Default value: 0 us" << std::endl << std::endl;
+   std::cout << " -L      Logger" << std::endl;
+   std::cout << "         std: the traces are written by the thread that produces them." << std::endl;
+   std::cout << "         async: the traces are queued in a lock free ring and written in batches by a background thread;" << std::endl;
+   std::cout << "         when the ring is full, the traces are dropped (and counted)." << std::endl;
+   std::cout << "         async-block: as async, but waiting for room in the ring instead of dropping." << std::endl;
+   std::cout << "         file, file-block: as async and async-block, but the traces and the errors are written to a file (-o), which" << std::endl;
+   std::cout << "         is rotated by size (-S) and age (-A). Errors are also written to the error output." << std::endl;
+   std::cout << "         binary: the traces are written as binary records (the call site and the raw arguments) into a memory" << std::endl;
+   std::cout << "         mapped file (-o), to be decoded offline with ncs-logdecode. Errors are also written to the error output." << std::endl;
+   std::cout << "         Default value: std" << std::endl << std::endl;
+   std::cout << " -o      Log file" << std::endl;
+   std::cout << "         The file written by the file logger, which appends to it, or by the binary logger, which replaces it." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_LOG_FILE << " (file), " << C_S_DEFAULT_BINARY_LOG_FILE << " (binary)" << std::endl << std::endl;
+   std::cout << " -S      Log rotation size" << std::endl;
+   std::cout << "         The file logger renames its file to <file>.1 (and <file>.1 to <file>.2, keeping " << lcr::FileLogger::C_S_DEFAULT_FILES << " files)" << std::endl;
+   std::cout << "         and starts a new one when it reaches this size in MB. When zero, the file is not rotated by size." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_LOG_ROTATE_SIZE << " MB" << std::endl << std::endl;
+   std::cout << " -A      Log rotation age" << std::endl;
+   std::cout << "         The file logger starts a new file when the current one is this number of seconds old. When zero, the file" << std::endl;
+   std::cout << "         is not rotated by age." << std::endl;
+   std::cout << "         Default value: 0 seconds" << std::endl << std::endl;
+   std::cout << " -k      MD5 kernel" << std::endl;
+   std::cout << "         The MD5 kernel used to hash batches of texts, overriding the one detected for the CPU (for testing purposes)." << std::endl;
+   std::cout << "         The LCR_MD5_KERNEL environment variable has the same effect." << std::endl;
+   std::cout << "         Posible values: [scalar, sse2, avx2, avx512]" << std::endl;
+   std::cout << "         Default value: the fastest kernel supported by the CPU" << std::endl << std::endl;
    std::cout << "Examples:" << std::endl;
    std::cout << "         server -h" << std::endl;
    std::cout << "         server --help" << std::endl;
@@ -164,6 +261,15 @@ void check(Arguments& args)
       logger.error(LOG_WARNING, "[MAIN] Port number %u is not in the range 1023-65535. Setting %d as default", args.port, C_S_DEFAULT_PORT);
       args.port = C_S_DEFAULT_PORT;
    }
+   // Check the metrics port number argument
+   if(args.metrics_port && (args.metrics_port<=1023 || args.metrics_port>65535)) {
+      logger.error(LOG_WARNING, "[MAIN] Invalid metrics port number (%d). The metrics are disabled", args.metrics_port);
+      args.metrics_port = 0;
+   }
+   else if(args.metrics_port && args.metrics_port==args.port) {
+      logger.error(LOG_WARNING, "[MAIN] The metrics port number (%d) is the server one. The metrics are disabled", args.metrics_port);
+      args.metrics_port = 0;
+   }
    // Check the cache capacity argument
    if(args.cache_capacity<0) {
       logger.error(LOG_WARNING, "[MAIN] Invalid cache capacity (%d). Setting %d as default", args.cache_capacity, C_S_DEFAULT_CACHE_CAPACITY);
@@ -174,35 +280,140 @@ void check(Arguments& args)
       logger.error(LOG_WARNING, "[MAIN] Invalid cache timeout (%d). Setting %d as default", args.cache_timeout, C_S_DEFAULT_CACHE_TIMEOUT);
       args.cache_timeout = C_S_DEFAULT_CACHE_TIMEOUT;
    }
-   logger.trace(LOG_LEVEL_1, "[MAIN]---- Execution parameters ---------------------------------------------------");
-   logger.trace(LOG_LEVEL_1, "[MAIN] Trace level   : %d", args.log_level);
-   logger.trace(LOG_LEVEL_1, "[MAIN] Port number   : %d", args.port);
-   logger.trace(LOG_LEVEL_1, "[MAIN] Cache capacity: %d entries", args.cache_capacity);
-   logger.trace(LOG_LEVEL_1, "[MAIN] Cache timeout : %d seconds", args.cache_timeout);
-   logger.trace(LOG_LEVEL_1, "[MAIN]-----------------------------------------------------------------------------");
+   // Check the prefix cache memory argument
+   if(args.prefix_memory<0) {
+      logger.error(LOG_WARNING, "[MAIN] Invalid prefix cache memory (%d). Disabling the prefix cache", args.prefix_memory);
+      args.prefix_memory = 0;
+   }
+   // Check the batch deadline argument
+   if(args.batch_deadline<0) {
+      logger.error(LOG_WARNING, "[MAIN] Invalid hash batch deadline (%d). Disabling the batches", args.batch_deadline);
+      args.batch_deadline = 0;
+   }
+   // Check the files root argument: it is kept as a canonical path, so the workers can check that the requested files are under it
+   if(!args.files_root.empty()) {
+      char resolved[PATH_MAX];
+      if(!realpath(args.files_root.c_str(), resolved)) {
+         logger.error(LOG_WARNING, "[MAIN] Invalid files root directory (%s). File requests are disabled", args.files_root.c_str());
+         args.files_root.clear();
+      }
+      else {
+         args.files_root = resolved;
+      }
+   }
+   // Check the logger argument
+   if(args.logger.empty()) {
+      args.logger = "std";
+   }
+   else if(args.logger!="std" && args.logger!="async" && args.logger!="async-block" && args.logger!="file" && args.logger!="file-block" &&
+           args.logger!="binary") {
+      logger.error(LOG_WARNING, "[MAIN] Invalid logger (%s). Setting std as default", args.logger.c_str());
+      args.logger = "std";
+   }
+   if(args.log_file.empty()) {
+      args.log_file = (args.logger=="binary") ? C_S_DEFAULT_BINARY_LOG_FILE : C_S_DEFAULT_LOG_FILE;
+   }
+   if(args.log_rotate_size==-1) { // Not given
+      args.log_rotate_size = C_S_DEFAULT_LOG_ROTATE_SIZE;
+   }
+   else if(args.log_rotate_size<0) {
+      logger.error(LOG_WARNING, "[MAIN] Invalid log rotation size (%d). Setting %d as default", args.log_rotate_size, C_S_DEFAULT_LOG_ROTATE_SIZE);
+      args.log_rotate_size = C_S_DEFAULT_LOG_ROTATE_SIZE;
+   }
+   if(args.log_rotate_age<0) {
+      logger.error(LOG_WARNING, "[MAIN] Invalid log rotation age (%d). Disabling the rotation by age", args.log_rotate_age);
+      args.log_rotate_age = 0;
+   }
+   // Check the MD5 kernel argument
+   if(!args.md5_kernel.empty()) {
+      lcr::MD5Kernel kernel;
+      if(!lcr::md5_kernel_from_name(args.md5_kernel, kernel)) {
+         logger.error(LOG_WARNING, "[MAIN] Invalid MD5 kernel (%s). Keeping %s", args.md5_kernel.c_str(), lcr::md5_kernel_name(lcr::md5_kernel()));
+      }
+      else if(!lcr::md5_select(kernel)) {
+         logger.error(LOG_WARNING, "[MAIN] MD5 kernel %s is not supported by this CPU. Keeping %s", args.md5_kernel.c_str(), lcr::md5_kernel_name(lcr::md5_kernel()));
+      }
+   }
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN]---- Execution parameters ---------------------------------------------------");
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Trace level   : %d", args.log_level);
+   if(args.logger=="file" || args.logger=="file-block") {
+      LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Logger        : %s => %s (rotation: %d MB, %d seconds)", args.logger.c_str(), args.log_file.c_str(),
+                args.log_rotate_size, args.log_rotate_age);
+   }
+   else {
+      LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Logger        : %s%s%s", args.logger.c_str(), (args.logger=="binary" ? " => " : ""),
+                (args.logger=="binary" ? args.log_file.c_str() : ""));
+   }
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Port number   : %d", args.port);
+   if(args.metrics_port) {
+      LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Metrics port  : %d (http://127.0.0.1:%d/metrics)", args.metrics_port, args.metrics_port);
+   }
+   else {
+      LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Metrics port  : <disabled>");
+   }
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Cache capacity: %d entries", args.cache_capacity);
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Cache timeout : %d seconds", args.cache_timeout);
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Prefix cache  : %d kB", args.prefix_memory);
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Hash batches  : %d us", args.batch_deadline);
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] Files root    : %s", args.files_root.empty() ? "<disabled>" : args.files_root.c_str());
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] MD5 kernel    : %s (batches), scalar (single texts)", lcr::md5_kernel_name(lcr::md5_kernel()));
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN] SHA kernel    : %s (sha1, sha256)", lcr::sha_kernel_name(lcr::sha_kernel()));
+   LCR_TRACE(logger, LOG_LEVEL_1, "[MAIN]-----------------------------------------------------------------------------");
+}
+
+
+// Function that creates the logger selected in the command line: from now on, every trace goes through it
+lcr::Logger& create_logger(const Arguments& args)
+{
+   if(args.logger=="std") {
+      s_logger_ptr = &lcr::StdLogger::instance(s_log_level);
+   }
+   else if(args.logger=="binary") {
+      try {
+         s_binary_logger_ptr.reset(new lcr::BinaryLogger(args.log_file, s_log_level));
+         s_logger_ptr = s_binary_logger_ptr.get();
+      }
+      catch(const lcr::RuntimeError& ex) {
+         s_logger_ptr = &lcr::StdLogger::instance(s_log_level);
+         s_logger_ptr->error(LOG_WARNING, "[MAIN] %s: %s. Setting std as logger", ex.what(), strerror(ex.ec()));
+      }
+   }
+   else if(args.logger=="file" || args.logger=="file-block") {
+      auto overflow = (args.logger=="file-block") ? lcr::AsyncLogger::Overflow::block : lcr::AsyncLogger::Overflow::drop;
+      s_async_logger_ptr.reset(new lcr::FileLogger(args.log_file, s_log_level, args.log_rotate_size * std::size_t(1024 * 1024),
+                                                   std::chrono::seconds(args.log_rotate_age), lcr::FileLogger::C_S_DEFAULT_FILES,
+                                                   lcr::AsyncLogger::C_S_DEFAULT_CAPACITY, overflow));
+      s_logger_ptr = s_async_logger_ptr.get();
+   }
+   else {
+      auto overflow = (args.logger=="async-block") ? lcr::AsyncLogger::Overflow::block : lcr::AsyncLogger::Overflow::drop;
+      s_async_logger_ptr.reset(new lcr::AsyncLogger(s_log_level, lcr::AsyncLogger::C_S_DEFAULT_CAPACITY, overflow));
+      s_logger_ptr = s_async_logger_ptr.get();
+   }
+   return *s_logger_ptr;
 }
 
 
 // Function that handles all required signals
 void signal_handler(int signum)
 {
-   auto & logger = lcr::StdLogger::instance(s_log_level);
+   auto & logger = *s_logger_ptr;
    switch(signum)
    {
       case SIGUSR1:
-         logger.trace(LOG_LEVEL_2, "[MAIN] Received SIGUSR1 [%d]", signum);
+         LCR_TRACE(logger, LOG_LEVEL_2, "[MAIN] Received SIGUSR1 [%d]", signum);
          s_server_ptr->clearCache();
          break;
       case SIGUSR2:
-         logger.trace(LOG_LEVEL_2, "[MAIN] Received SIGUSR2 [%d]", signum);
+         LCR_TRACE(logger, LOG_LEVEL_2, "[MAIN] Received SIGUSR2 [%d]", signum);
          s_server_ptr->printCache();
          break;
       case SIGTERM:
-         logger.trace(LOG_LEVEL_2, "[MAIN] Received SIGTERM [%d]", signum);
+         LCR_TRACE(logger, LOG_LEVEL_2, "[MAIN] Received SIGTERM [%d]", signum);
          s_server_ptr->finish();
          break;
       case SIGINT:
-         logger.trace(LOG_LEVEL_2, "[MAIN] Received SIGINT [%d]", signum);
+         LCR_TRACE(logger, LOG_LEVEL_2, "[MAIN] Received SIGINT [%d]", signum);
          s_server_ptr->cancel();
          break;
    }
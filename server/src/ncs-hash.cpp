@@ -0,0 +1,357 @@
+//------------------------------------------------------------------------------------------
+//  File:        ncs-hash.cpp
+//
+//  Desc:        Offline bulk hashing: walks directory trees and prints the MD5 of every
+//               regular file in the md5sum format, so its output can be checked with
+//               'md5sum -c' or used to pre-populate caches.
+//
+//------------------------------------------------------------------------------------------
+
+// Stl
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <string.h>
+#include <iostream>
+#include <filesystem>
+
+// Posix
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// lib locar
+#include "lcr/md5.h"
+#include "lcr/StdLogger.h"
+#include "lcr/CommandLine.hpp"
+#include "lcr/WorkStealingPool.hpp"
+
+
+
+// Definitions /////////////////////////////////////////////////////////////////////
+struct Arguments // The Arguments type stores the parameters from the command line after parsing
+{
+   int threads{};        // The number of hashing threads. When zero, one per CPU.
+   bool statistics{};    // Flag to print the run statistics on the error output
+};
+
+struct Task // A task of the walk: a directory to list, a large file or a batch of small files to hash
+{
+   std::string directory;           // The directory to list
+   std::string file;                // The large file to hash
+   std::vector<std::string> files;  // The batch of small files to hash
+};
+
+struct Buffers // The buffers of a thread, reused by all its tasks
+{
+   std::vector<char> chunk;              // Chunk for large files
+   std::vector<std::string> contents;    // Contents of a batch of small files
+   std::vector<std::string_view> texts;
+   std::vector<lcr::MD5::Digest> digests;
+};
+
+
+// Prototypes //////////////////////////////////////////////////////////////////////
+void show_usage(); // Function that shows the program usage
+std::vector<std::string> paths(int argc, const char* argv[]); // Function that returns the command line arguments that are not options
+void list_directory(const std::string& directory, lcr::WorkStealingPool<Task>& pool, unsigned int thread); // Function that creates the tasks for the entries of a directory
+void hash_small_files(const std::vector<std::string>& files, Buffers& buffers); // Function that hashes a batch of small files with the multi-buffer kernel
+void hash_large_file(const std::string& file, Buffers& buffers); // Function that hashes a large file by chunks
+bool read_file(const std::string& file, int fd, int ec, std::string& content); // Function that reads a whole small file
+void print_digest(const std::string& file, const lcr::MD5::Digest& digest, std::string& output); // Function that formats a line as md5sum does
+
+
+// Static constants ////////////////////////////////////////////////////////////////
+static const std::size_t C_S_SMALL_FILE = 64 * 1024;     // Files up to this size are hashed in batches
+static const std::size_t C_S_BATCH = 16;                 // Files per batch: the lanes of the widest kernel
+static const std::size_t C_S_CHUNK = 1024 * 1024;        // Read size for large files
+
+// Static objects /////////////////////////////////////////////////////////////////
+static std::mutex s_output_mutex;
+static std::atomic<unsigned long long> s_files;
+static std::atomic<unsigned long long> s_bytes;
+static std::atomic<unsigned long long> s_errors;
+
+
+
+int main(int argc, const char* argv[])
+{
+   // Look for the sow_help parameter
+   if(argc==1 || (argc==2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))) {
+      show_usage();
+      return 0;
+   } // else ...
+
+   // Specify the input parameters and proceed to parse the command line
+   auto args = lcr::CommandLine<Arguments>::Parser({
+      {"-j", &Arguments::threads},
+      {"-s", &Arguments::statistics}
+   })->parse(argc, argv);
+   if(args.threads<=0) {
+      args.threads = std::max(1u, std::thread::hardware_concurrency());
+   }
+
+   // Errors are written on the error output, the digests on the standard output
+   auto & logger = lcr::StdLogger::instance(1);
+
+   std::vector<Buffers> buffers(args.threads);
+   lcr::WorkStealingPool<Task> pool(args.threads, [&pool, &buffers](Task& task, unsigned int thread) {
+      if(!task.directory.empty()) {
+         list_directory(task.directory, pool, thread);
+      }
+      else if(!task.file.empty()) {
+         hash_large_file(task.file, buffers[thread]);
+      }
+      else {
+         hash_small_files(task.files, buffers[thread]);
+      }
+   });
+
+   // The initial tasks: the directories to walk and the files given as arguments
+   std::vector<Task> tasks;
+   for(const auto& path : paths(argc, argv)) {
+      std::error_code ec;
+      if(std::filesystem::is_directory(path, ec)) {
+         tasks.push_back({path, "", {}});
+      }
+      else if(std::filesystem::is_regular_file(path, ec)) {
+         tasks.push_back({"", path, {}});
+      }
+      else {
+         logger.error(LOG_WARNING, "[HASH] %s: No such file or directory", path.c_str());
+         ++s_errors;
+      }
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   int rc = 0;
+   try {
+      pool.run(std::move(tasks));
+   }
+   catch(const std::exception& ex) {
+      logger.error(LOG_ERROR, "[HASH] %s", ex.what());
+      rc = 2;
+   }
+   fflush(stdout);
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+   if(args.statistics) {
+      fprintf(stderr, "%llu files, %llu bytes in %.3f s (%.2f MB/s) - %u threads, %llu steals, %llu errors\n",
+         s_files.load(), s_bytes.load(), elapsed.count(), s_bytes / elapsed.count() / 1e6, pool.threads(), pool.steals(), s_errors.load());
+   }
+   return rc ? rc : (s_errors ? 1 : 0);
+}
+
+
+
+// Function that shows the program usage
+void show_usage()
+{
+   std::cout << "---- Command line -----------------------------------------------------------------------------------------------------" << std::endl << std::endl;
+   std::cout << " ncs-hash [options] path..." << std::endl << std::endl;
+   std::cout << " Prints the MD5 of every regular file under the paths in the md5sum format. Symbolic links are not followed." << std::endl << std::endl;
+   std::cout << " -h      Program help" << std::endl;
+   std::cout << " --help  Show details of the program usage" << std::endl << std::endl;
+   std::cout << " -j      Number of threads" << std::endl;
+   std::cout << "         Default value: one per CPU" << std::endl << std::endl;
+   std::cout << " -s      Statistics" << std::endl;
+   std::cout << "         When 1, prints the number of files and bytes hashed and the throughput on the error output." << std::endl;
+   std::cout << "         Default value: 0" << std::endl << std::endl;
+   std::cout << "Examples:" << std::endl;
+   std::cout << "         ncs-hash -j 8 /srv/data > data.md5" << std::endl;
+   std::cout << "         md5sum -c data.md5" << std::endl;
+   std::cout << "-----------------------------------------------------------------------------------------------------------------------" << std::endl;
+}
+
+
+// Function that returns the command line arguments that are not options
+std::vector<std::string> paths(int argc, const char* argv[])
+{
+   std::vector<std::string> paths;
+   for(int ii=1; ii<argc; ++ii) {
+      if(argv[ii][0]=='-' && argv[ii][1]!='\0') {
+         ++ii; // Every option has a value
+      }
+      else {
+         paths.push_back(argv[ii]);
+      }
+   }
+   return paths;
+}
+
+
+// Function that creates the tasks for the entries of a directory: one task per subdirectory, one per large file
+// and one per batch of small files. Symbolic links are skipped, as 'find -type f' does, so the walk cannot loop.
+void list_directory(const std::string& directory, lcr::WorkStealingPool<Task>& pool, unsigned int thread)
+{
+   auto & logger = lcr::StdLogger::instance(0);
+   std::error_code ec;
+   std::filesystem::directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, ec);
+   Task batch;
+   for(; !ec && it!=std::filesystem::directory_iterator(); it.increment(ec)) {
+      std::error_code status_ec;
+      auto status = it->symlink_status(status_ec);
+      if(std::filesystem::is_directory(status)) {
+         pool.push({it->path().string(), "", {}}, thread);
+      }
+      else if(std::filesystem::is_regular_file(status)) {
+         if(it->file_size(status_ec) > C_S_SMALL_FILE) {
+            pool.push({"", it->path().string(), {}}, thread);
+         }
+         else {
+            batch.files.push_back(it->path().string());
+            if(batch.files.size()==C_S_BATCH) {
+               pool.push(std::move(batch), thread);
+               batch = Task();
+            }
+         }
+      }
+   }
+   if(ec) {
+      logger.error(LOG_WARNING, "[HASH] %s: %s", directory.c_str(), ec.message().c_str());
+      ++s_errors;
+   }
+   if(!batch.files.empty()) {
+      pool.push(std::move(batch), thread);
+   }
+}
+
+
+// Function that hashes a batch of small files: all of them are opened and announced to the kernel first,
+// so their reads are in flight at the same time, and then the whole batch goes through the multi-buffer kernel
+void hash_small_files(const std::vector<std::string>& files, Buffers& buffers)
+{
+   std::vector<int> fds(files.size(), -1);
+   std::vector<int> errors(files.size(), 0); // The errno of the opens that failed, reported when the file is read
+   for(std::size_t ii=0; ii<files.size(); ++ii) {
+      fds[ii] = open(files[ii].c_str(), O_RDONLY);
+      if(fds[ii]!=-1) {
+         posix_fadvise(fds[ii], 0, 0, POSIX_FADV_WILLNEED);
+      }
+      else {
+         errors[ii] = errno;
+      }
+   }
+   buffers.contents.resize(files.size());
+   buffers.texts.clear();
+   std::vector<std::size_t> hashed;
+   for(std::size_t ii=0; ii<files.size(); ++ii) {
+      if(read_file(files[ii], fds[ii], errors[ii], buffers.contents[ii])) {
+         buffers.texts.push_back(buffers.contents[ii]);
+         hashed.push_back(ii);
+      }
+      if(fds[ii]!=-1) {
+         close(fds[ii]);
+      }
+   }
+   buffers.digests.resize(buffers.texts.size());
+   lcr::md5_many(buffers.texts.data(), buffers.digests.data(), buffers.texts.size());
+
+   std::string output;
+   for(std::size_t ii=0; ii<hashed.size(); ++ii) {
+      print_digest(files[hashed[ii]], buffers.digests[ii], output);
+      s_bytes += buffers.texts[ii].size();
+   }
+   s_files += hashed.size();
+   std::lock_guard<std::mutex> guard(s_output_mutex);
+   fwrite(output.data(), 1, output.size(), stdout);
+}
+
+
+// Function that hashes a large file by chunks. The sequential advice doubles the kernel read ahead,
+// so the next chunks are being read from the device while the current one is hashed.
+void hash_large_file(const std::string& file, Buffers& buffers)
+{
+   auto & logger = lcr::StdLogger::instance(0);
+   int fd = open(file.c_str(), O_RDONLY);
+   if(fd==-1) {
+      logger.error(LOG_WARNING, "[HASH] %s: %s", file.c_str(), strerror(errno));
+      ++s_errors;
+      return;
+   }
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+   buffers.chunk.resize(C_S_CHUNK);
+   lcr::MD5 md5;
+   unsigned long long bytes = 0;
+   ssize_t n;
+   while((n = read(fd, buffers.chunk.data(), buffers.chunk.size())) > 0) {
+      md5.update(buffers.chunk.data(), n);
+      bytes += n;
+   }
+   int ec = errno;
+   close(fd);
+   if(n==-1) {
+      logger.error(LOG_WARNING, "[HASH] %s: %s", file.c_str(), strerror(ec));
+      ++s_errors;
+      return;
+   }
+   std::string output;
+   print_digest(file, md5.finalize().binarydigest(), output);
+   ++s_files;
+   s_bytes += bytes;
+   std::lock_guard<std::mutex> guard(s_output_mutex);
+   fwrite(output.data(), 1, output.size(), stdout);
+}
+
+
+// Function that reads a whole file, even if it has grown since it was listed. When the file could not be opened, fd
+// is -1 and ec is the errno of the open, saved then because the other files of the batch were opened since
+bool read_file(const std::string& file, int fd, int ec, std::string& content)
+{
+   auto & logger = lcr::StdLogger::instance(0);
+   content.clear();
+   struct stat st;
+   if(fd!=-1 && fstat(fd, &st)==-1) {
+      ec = errno;
+   }
+   else if(fd!=-1) {
+      content.resize(st.st_size + 1); // One more byte to see the end of file without growing
+      std::size_t bytes = 0;
+      ssize_t n;
+      while((n = read(fd, &content[bytes], content.size() - bytes)) > 0) {
+         bytes += n;
+         if(bytes==content.size()) {
+            content.resize(2 * content.size());
+         }
+      }
+      ec = errno;
+      content.resize(bytes);
+      if(n==0) {
+         return true;
+      }
+   }
+   logger.error(LOG_WARNING, "[HASH] %s: %s", file.c_str(), strerror(ec));
+   ++s_errors;
+   return false;
+}
+
+
+// Function that formats a line as md5sum does: "<digest>  <file>". A file name with a backslash or a new line
+// is escaped, and its line starts with a backslash.
+void print_digest(const std::string& file, const lcr::MD5::Digest& digest, std::string& output)
+{
+   bool escape = file.find_first_of("\\\n") != std::string::npos;
+   char hex[32];
+   lcr::md5_hex(digest, hex);
+   if(escape) {
+      output += '\\';
+   }
+   output.append(hex, sizeof(hex));
+   output += "  ";
+   for(char c : file) {
+      if(escape && c=='\\') {
+         output += "\\\\";
+      }
+      else if(escape && c=='\n') {
+         output += "\\n";
+      }
+      else {
+         output += c;
+      }
+   }
+   output += '\n';
+}
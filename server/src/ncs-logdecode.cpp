@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------------------
+//  File:        ncs-logdecode.cpp
+//
+//  Desc:        Offline decoder of the binary logs written by the server with '-L binary':
+//               prints their traces as the text loggers would have written them.
+//
+//------------------------------------------------------------------------------------------
+
+// Stl
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+
+// lib locar
+#include "lcr/StdLogger.h"
+#include "lcr/BinaryLogger.h"
+#include "lcr/CommandLine.hpp"
+
+
+
+// Definitions /////////////////////////////////////////////////////////////////////
+struct Arguments // The Arguments type stores the parameters from the command line after parsing
+{
+   bool statistics{};    // Flag to print the number of records decoded, dropped and skipped on the error output
+};
+
+
+// Prototypes //////////////////////////////////////////////////////////////////////
+void show_usage(); // Function that shows the program usage
+std::vector<std::string> paths(int argc, const char* argv[]); // Function that returns the command line arguments that are not options
+
+
+
+int main(int argc, const char* argv[])
+{
+   // Look for the sow_help parameter
+   if(argc==1 || (argc==2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))) {
+      show_usage();
+      return 0;
+   } // else ...
+
+   // Specify the input parameters and proceed to parse the command line
+   auto args = lcr::CommandLine<Arguments>::Parser({
+      {"-s", &Arguments::statistics}
+   })->parse(argc, argv);
+
+   // Errors are written on the error output, the traces on the standard output
+   auto & logger = lcr::StdLogger::instance(1);
+
+   int rc = 0;
+   std::string line;
+   for(const auto& path : paths(argc, argv)) {
+      lcr::BinaryLogReader reader(path);
+      if(reader.error()) {
+         logger.error(LOG_WARNING, "[DECODE] %s", reader.message().c_str());
+         rc = 1;
+         continue;
+      }
+      unsigned long long records = 0;
+      while(reader.next(line)) {
+         line += '\n';
+         fwrite(line.data(), 1, line.size(), stdout);
+         ++records;
+      }
+      if(reader.dropped()) {
+         logger.error(LOG_WARNING, "[DECODE] %s: %llu records were dropped because the file was full", path.c_str(), reader.dropped());
+      }
+      if(reader.unclosed()) {
+         logger.error(LOG_WARNING, "[DECODE] %s: the file was not closed by the logger, the last records may be missing", path.c_str());
+      }
+      if(args.statistics) {
+         fprintf(stderr, "%s: %llu records decoded, %llu dropped, %llu skipped\n", path.c_str(), records, reader.dropped(), reader.skipped());
+      }
+   }
+   fflush(stdout);
+   return rc;
+}
+
+
+
+// Function that shows the program usage
+void show_usage()
+{
+   std::cout << "---- Command line -----------------------------------------------------------------------------------------------------" << std::endl << std::endl;
+   std::cout << " ncs-logdecode [options] file..." << std::endl << std::endl;
+   std::cout << " Prints the traces of binary log files (written by 'server -L binary') as text, in local time." << std::endl << std::endl;
+   std::cout << " -h      Program help" << std::endl;
+   std::cout << " --help  Show details of the program usage" << std::endl << std::endl;
+   std::cout << " -s      Statistics" << std::endl;
+   std::cout << "         When 1, prints the number of records decoded, dropped and skipped on the error output." << std::endl;
+   std::cout << "         Default value: 0" << std::endl << std::endl;
+   std::cout << "Examples:" << std::endl;
+   std::cout << "         ncs-logdecode server.blog | grep WORKER" << std::endl;
+   std::cout << "-----------------------------------------------------------------------------------------------------------------------" << std::endl;
+}
+
+
+// Function that returns the command line arguments that are not options
+std::vector<std::string> paths(int argc, const char* argv[])
+{
+   std::vector<std::string> paths;
+   for(int ii=1; ii<argc; ++ii) {
+      if(argv[ii][0]=='-' && argv[ii][1]!='\0') {
+         ++ii; // Every option has a value
+      }
+      else {
+         paths.push_back(argv[ii]);
+      }
+   }
+   return paths;
+}
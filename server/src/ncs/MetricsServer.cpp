@@ -0,0 +1,197 @@
+//------------------------------------------------------------------------------------------
+//  Class:       ncs::MetricsServer
+//  File:        ncs/MetricsServer.cpp
+//
+//------------------------------------------------------------------------------------------
+#include "MetricsServer.h"
+
+// Stl
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+// sockets
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <poll.h>
+
+// lib locar
+#include "lcr/Exceptions.hpp"
+#include "lcr/LogLimiter.hpp"
+
+
+namespace ncs
+{
+
+// The time that the main loop waits for connections before checking the stop flag, in milliseconds
+static const int C_S_POLL_TIMEOUT = 200;
+
+// The time that a client has to send its request and to take the response, in milliseconds
+static const int C_S_CLIENT_TIMEOUT = 1000;
+
+// The maximum size of a request: the request line and the headers
+static const std::size_t C_S_REQUEST_SIZE = 8 * 1024;
+
+// The warnings written per second by each call site: clients can trigger them at will
+static const unsigned int C_S_WARNINGS_PER_SECOND = 10;
+
+
+MetricsServer::MetricsServer(unsigned int port, const Server& server, lcr::Logger& logger)
+   : logger_(logger)
+   , server_(server)
+   , port_(port)
+   , sockfd_(-1)
+   , request_()
+   , response_()
+   , stop_()
+   , thread_()
+{
+   sockfd_ = socket(AF_INET, SOCK_STREAM, 0);
+   if(sockfd_==-1) {
+      throw lcr::RuntimeError("Failed to open the metrics socket", errno);
+   }
+   int reuse = 1;
+   setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+   // Bind the metrics socket to the loopback address: the statistics are not published outside the host
+   struct sockaddr_in addr;
+   std::memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons(port_);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if(bind(sockfd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr))==-1 || listen(sockfd_, 10)==-1) {
+      int ec = errno;
+      close(sockfd_);
+      throw lcr::RuntimeError("Unable to listen on the metrics socket", ec);
+   }
+   request_.reserve(C_S_REQUEST_SIZE);
+   thread_ = std::thread(&MetricsServer::run_, this);
+   LCR_TRACE(logger_, LOG_LEVEL_4, "[METRICS] Serving the metrics on http://127.0.0.1:%u/metrics", port_);
+}
+
+MetricsServer::~MetricsServer()
+{
+   stop_ = true;
+   thread_.join();
+   close(sockfd_);
+   LCR_TRACE(logger_, LOG_LEVEL_4, "[METRICS] The metrics server has finished");
+}
+
+
+void MetricsServer::run_()
+{
+   struct pollfd fds[1];
+   fds[0].fd = sockfd_;
+   fds[0].events = POLLIN;
+   while(!stop_) {
+      int nfds = poll(fds, 1, C_S_POLL_TIMEOUT);
+      if(nfds==-1) {
+         if(errno!=EINTR) { // If not is an interrupt call
+            logger_.error(LOG_WARNING, "[METRICS] Failed while polling in the metrics socket (%d). The metrics are disabled", errno);
+            break;
+         }
+      }
+      else if(nfds>0 && (fds[0].revents & POLLIN)) {
+         int client_sockfd = accept(sockfd_, nullptr, nullptr);
+         if(client_sockfd==-1) {
+            LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[METRICS] Unable to accept a connection (%d)", errno);
+            continue;
+         }
+         serve_(client_sockfd);
+         close(client_sockfd);
+      }
+   }
+}
+
+
+// Private method that reads the request line and the headers, waiting for them at most the client timeout, and answers
+// 'GET /metrics' (the query string is ignored) with the statistics, anything else with an error
+void MetricsServer::serve_(int sockfd)
+{
+   auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(C_S_CLIENT_TIMEOUT);
+   request_.clear();
+   char buffer[1024];
+   while(request_.find("\r\n\r\n")==std::string::npos && request_.find("\n\n")==std::string::npos) {
+      int timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+      struct pollfd fds[1];
+      fds[0].fd = sockfd;
+      fds[0].events = POLLIN;
+      if(request_.size()>=C_S_REQUEST_SIZE || timeout<=0 || poll(fds, 1, timeout)<=0) {
+         LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[METRICS] Incomplete request: %zu bytes received", request_.size());
+         return;
+      }
+      ssize_t bytes = recv(sockfd, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if(bytes<=0) {
+         if(bytes==-1 && (errno==EAGAIN || errno==EINTR)) {
+            continue;
+         }
+         return; // The client has gone
+      }
+      request_.append(buffer, bytes);
+   }
+
+   // The request line: 'METHOD target HTTP/1.x'
+   std::string line = request_.substr(0, request_.find_first_of("\r\n"));
+   std::size_t space = line.find(' ');
+   std::string method = line.substr(0, space);
+   std::string target = (space==std::string::npos) ? "" : line.substr(space + 1, line.find(' ', space + 1) - space - 1);
+   target = target.substr(0, target.find('?'));
+   int status = 200;
+   const char * reason = "OK";
+   std::string body;
+   if(method!="GET") {
+      status = 405;
+      reason = "Method Not Allowed";
+      body = "Only GET is allowed\n";
+   }
+   else if(target!="/metrics") {
+      status = 404;
+      reason = "Not Found";
+      body = "Not found: the metrics are in /metrics\n";
+   }
+   else {
+      server_.exportMetrics(body);
+   }
+
+   char header[256];
+   snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %zu\r\n%sConnection: close\r\n\r\n",
+            status, reason, body.size(), (status==405) ? "Allow: GET\r\n" : "");
+   response_ = header;
+   response_ += body;
+   if(send_(sockfd, response_)) {
+      LCR_TRACE(logger_, LOG_LEVEL_5, "[METRICS] %s %s => %d (%zu bytes)", method.c_str(), target.c_str(), status, body.size());
+   }
+}
+
+
+bool MetricsServer::send_(int sockfd, const std::string& response)
+{
+   auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(C_S_CLIENT_TIMEOUT);
+   std::size_t sent = 0;
+   while(sent<response.size()) {
+      ssize_t bytes = send(sockfd, response.data() + sent, response.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if(bytes>=0) {
+         sent += bytes;
+         continue;
+      }
+      if(errno!=EAGAIN && errno!=EINTR) {
+         LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[METRICS] Sending error: (%d)", errno);
+         return false;
+      }
+      int timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+      struct pollfd fds[1];
+      fds[0].fd = sockfd;
+      fds[0].events = POLLOUT;
+      if(timeout<=0 || poll(fds, 1, timeout)<=0) {
+         LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[METRICS] The client did not take the response in time: %zu of %zu bytes sent",
+                           sent, response.size());
+         return false;
+      }
+   }
+   return true;
+}
+
+
+} // namespace ncs
@@ -0,0 +1,74 @@
+//---------------------------------------------------------------------------
+//  Class:       ncs::MetricsServer
+//  File:        ncs/MetricsServer.h
+//
+//---------------------------------------------------------------------------
+
+#ifndef SERVER__ncs_MetricsServer__H_
+#define SERVER__ncs_MetricsServer__H_
+
+
+// Stl
+#include <atomic>
+#include <string>
+#include <thread>
+
+// Components
+#include "Server.h"
+
+// lib locar
+#include "lcr/Logger.h"
+
+
+namespace ncs
+{
+
+// This class serves the statistics of the server in the Prometheus text format on a local admin port. It is a minimal
+// HTTP server with a thread of its own, which answers 'GET /metrics' and closes every connection after its response.
+// The statistics are read from counters updated without locks, so a scrape never takes the cache lock, and a slow
+// client only delays the next scrape, never the requests of the server.
+class MetricsServer
+{
+   public:
+      // The constructor receives as parameters the port number where it listens, on the loopback address, the server
+      // whose statistics are served and a reference to the logger to show traces of its operation.
+      // It throws a RuntimeError if it can not listen on the port.
+      MetricsServer(unsigned int port, const Server& server, lcr::Logger& logger);
+      // Destroyer: stops the thread
+      virtual ~MetricsServer();
+
+   private:
+      // Private method with the main loop of the thread
+      void run_();
+      // Private method that reads a request from a connection and answers it
+      void serve_(int sockfd);
+      // Private method that sends a response, returns false if the client does not take it in time
+      bool send_(int sockfd, const std::string& response);
+
+   private: // Non-copyable.
+      MetricsServer(const MetricsServer&) = delete;
+      MetricsServer& operator=(const MetricsServer&) = delete;
+
+   private:
+      // The logger reference
+      lcr::Logger& logger_;
+
+      // The server whose statistics are served
+      const Server& server_;
+
+      // The port number and the socket descriptor
+      unsigned int port_;
+      int sockfd_;
+
+      // The buffers of the request and the response, reused by every connection
+      std::string request_;
+      std::string response_;
+
+      // The thread and its stop flag
+      std::atomic<bool> stop_;
+      std::thread thread_;
+};
+
+} // namespace ncs
+
+#endif // !defined SERVER__ncs_MetricsServer__H_
@@ -7,38 +7,59 @@
 
 // Stl
 #include <thread>
+#include <fstream>
 #include <errno.h>
 #include <strings.h>
 // sockets
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <poll.h>
 
 // lib locar
 #include "lcr/Exceptions.hpp"
+#include "lcr/LogLimiter.hpp"
 
 
 namespace ncs
 {
 
-Server::Server(unsigned int port, unsigned int cache_capacity, unsigned int cache_timeout, lcr::Logger& logger)
+// The warnings written per second by each call site: a flood of connections can trigger them at will
+static const unsigned int C_S_WARNINGS_PER_SECOND = 10;
+
+
+Server::Server(unsigned int port, unsigned int cache_capacity, unsigned int cache_timeout, const std::string& root, std::size_t prefix_memory,
+               std::chrono::microseconds batch_deadline, lcr::Logger& logger)
    : logger_(logger)
    , port_(port)
-   , sockfd_()
+   , sockfd_(-1)
+   , sockfd_mutex_()
+   , root_(root)
    , finish_()
    , cancel_()
    , clear_()
    , print_()
-   , cache_(cache_capacity, cache_timeout, logger)
+   , reserved_resource_(std::pmr::new_delete_resource())
+   , pool_resource_(&reserved_resource_)
+   , used_resource_(&pool_resource_)
+   , cache_(cache_capacity, cache_timeout, logger, &used_resource_)
+   , prefixes_(prefix_memory ? new lcr::MD5PrefixCache(prefix_memory) : nullptr)
+   , batcher_(batch_deadline.count() ? new lcr::HashBatcher(batch_deadline) : nullptr)
    , sequence_()
    , tasks_()
    , workers_()
    , errors_()
    , unattended_requests_()
+   , in_flight_()
+   , hashed_()
+   , hashing_time_()
+   , streamed_()
+   , streaming_time_()
+   , latencies_()
 {
-   logger_.trace(LOG_LEVEL_4, "[SERVER] The server is ready");
+   LCR_TRACE(logger_, LOG_LEVEL_4, "[SERVER] The server is ready");
 }
 
 Server::~Server()
@@ -46,7 +67,19 @@ Server::~Server()
    if(!tasks_.empty()) {
       wait_for_tasks_();
    }
-   logger_.trace(LOG_LEVEL_4, "[SERVER] The server has finished");
+   LCR_TRACE(logger_, LOG_LEVEL_4, "[SERVER] The server has finished");
+}
+
+
+// Function that returns the resident set size of the process in bytes, or zero when it is not available
+static std::size_t resident_memory()
+{
+   std::size_t pages = 0, resident = 0;
+   std::ifstream statm("/proc/self/statm");
+   if(statm >> pages >> resident) {
+      return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+   }
+   return 0;
 }
 
 
@@ -57,8 +90,8 @@ bool future_is_ready(std::future<T>& t){
 
 int Server::run()
 {
-   int sockfd_ = socket(AF_INET, SOCK_STREAM, 0);
-   if(sockfd_==-1) {
+   int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+   if(sockfd==-1) {
       throw lcr::RuntimeError("Failed to open the server socket", errno);
    }
 
@@ -69,25 +102,29 @@ int Server::run()
    server_addr.sin_port = htons(port_);
    server_addr.sin_addr.s_addr = INADDR_ANY;
    bzero(&server_addr.sin_zero, 0);
-   if(bind(sockfd_, reinterpret_cast<struct sockaddr *>(&server_addr), sizeof(struct sockaddr_in)) == -1) {
+   if(bind(sockfd, reinterpret_cast<struct sockaddr *>(&server_addr), sizeof(struct sockaddr_in)) == -1) {
       throw lcr::RuntimeError("Failed to bind the server socket", errno);
    }
 
    // Listen on the server socket
-   if(listen(sockfd_, 10) == -1) {
+   if(listen(sockfd, 10) == -1) {
       throw lcr::RuntimeError("Unable to listen on the server socket", errno);
    }
+   {
+      std::lock_guard<std::mutex> guard(sockfd_mutex_);
+      sockfd_ = sockfd;
+   }
 
    struct sockaddr_in client_addr;
-   int len=sizeof(sockaddr_in);
+   socklen_t len=sizeof(sockaddr_in);
 
    struct pollfd fds[1];
-   fds[0].fd = sockfd_;
+   fds[0].fd = sockfd;
    fds[0].events = POLLIN;
 
    // Server main operation loop
    while(!finish_ && !cancel_) {
-//      logger_.trace(LOG_LEVEL_6, "[SERVER] executing server main operations ...");
+//      LCR_TRACE(logger_, LOG_LEVEL_6, "[SERVER] executing server main operations ...");
       int nfds = poll(fds, 1, 1000);
       if(nfds==-1) {
          if(errno!=EINTR) { // If not is an interrupt call
@@ -96,24 +133,32 @@ int Server::run()
       }
       else if(nfds>0) {
          if(fds[0].revents & POLLIN) { // Data received
-            int client_sockfd = accept(sockfd_, reinterpret_cast<struct sockaddr *>(&client_addr), &len);
+            int client_sockfd = accept(sockfd, reinterpret_cast<struct sockaddr *>(&client_addr), &len);
             if(client_sockfd==-1){
                throw lcr::RuntimeError("Unable to accept connections on the server socket", errno);
             }
             // Create a worker to process the request, with a unique sequence identifier and a random time delay
-            std::shared_ptr<Worker> worker(new Worker(++sequence_, client_sockfd, client_addr, cache_, logger_));
+            std::shared_ptr<Worker> worker(new Worker(++sequence_, client_sockfd, client_addr, cache_, root_, prefixes_.get(), batcher_.get(), logger_));
             try {
-               // Create the new worker task
+               // Create the new worker task, counted as in flight until the worker finishes
+               in_flight_.fetch_add(1, std::memory_order_relaxed);
                tasks_.push_back(
-                  {worker, std::async(std::launch::async, &Worker::exec, worker.get())}
+                  {worker, std::async(std::launch::async, [this, worker = worker.get()]() {
+                     struct Finished { // Even if the worker throws
+                        std::atomic<unsigned int>& in_flight;
+                        ~Finished() { in_flight.fetch_sub(1, std::memory_order_relaxed); }
+                     } finished{in_flight_};
+                     worker->exec();
+                  })}
                );
                // Increment the total number of workers
                ++workers_;
             }
             catch(const std::system_error& ex) {
-               logger_.error(LOG_WARNING, "[WORKER] Unable to fulfill the request: %s", ex.what(), unattended_requests_);
-               ++unattended_requests_;
-               logger_.error(LOG_WARNING, "[WORKER] %llu unattended requests until now", unattended_requests_);
+               in_flight_.fetch_sub(1, std::memory_order_relaxed);
+               unsigned long long unattended = ++unattended_requests_;
+               LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] Unable to fulfill the request: %s - %llu unattended requests until now",
+                                 ex.what(), unattended);
             }
          }
       }
@@ -138,8 +183,12 @@ int Server::run()
       // Update the worker threads
       update_tasks_();
    }
-   close(sockfd_);
-   logger_.trace(LOG_LEVEL_1, "[SERVER] The server will not attend any more requests", tasks_.size());
+   {
+      std::lock_guard<std::mutex> guard(sockfd_mutex_);
+      close(sockfd_);
+      sockfd_ = -1;
+   }
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] The server will not attend any more requests", tasks_.size());
    int rc; // The method return code
    if(finish_) {
       wait_for_tasks_();
@@ -158,16 +207,146 @@ int Server::run()
 
 void Server::printStatistics() const
 {
-   logger_.trace(LOG_LEVEL_1, "[SERVER]---- Server statistics ------------------------------------------------------");
-   logger_.trace(LOG_LEVEL_1, "[SERVER] Total number of executed workers: %llu", workers_);
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER]---- Server statistics ------------------------------------------------------");
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Total number of executed workers: %llu", workers_.load());
    if(errors_) {
-      logger_.trace(LOG_LEVEL_1, "[SERVER] Total errors reported by workers: %llu", errors_);
+      LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Total errors reported by workers: %llu", errors_.load());
    }
    else {
-      logger_.trace(LOG_LEVEL_1, "[SERVER] No errors reported by workers");
+      LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] No errors reported by workers");
+   }
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Unattended input requests: %llu", unattended_requests_.load());
+   auto rate = [](unsigned long long bytes, std::chrono::nanoseconds time) { return time.count() ? bytes * 1000.0 / time.count() : 0.0; }; // MB/s
+   unsigned long long hashed = hashed_ + (batcher_ ? batcher_->bytes() : 0);
+   std::chrono::nanoseconds hashing_time = hashing_time_ + (batcher_ ? batcher_->hashingTime() : std::chrono::nanoseconds());
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Hashed data: [bytes:%llu] [hashing:%.2f MB/s] [streamed bodies:%llu bytes, %.2f MB/s]",
+      hashed, rate(hashed, hashing_time), streamed_, rate(streamed_, streaming_time_));
+   if(prefixes_) {
+      unsigned long long saved = prefixes_->bytesSaved(), total = saved + prefixes_->bytesHashed();
+      LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Prefix cache: [prefixes:%zu] [memory:%zu bytes] [hits:%llu] [misses:%llu] [bytes saved:%llu (%.2f%%)] [resets:%llu]",
+         prefixes_->nodes(), prefixes_->memory(), prefixes_->hits(), prefixes_->misses(), saved, total ? 100.0 * saved / total : 0.0, prefixes_->resets());
+   }
+   if(batcher_) {
+      unsigned long long requests = batcher_->requests();
+      LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Hash batcher: [batches:%llu] [texts:%llu] [fill rate:%.2f%% of %u lanes] [queueing: avg %.1f us, max %.1f us] [deadline:%lld us]",
+         batcher_->batches(), requests, 100.0 * batcher_->fillRate(), batcher_->lanes(), requests ? batcher_->queueingTime().count() / 1000.0 / requests : 0.0,
+         batcher_->maxQueueingTime().count() / 1000.0, static_cast<long long>(batcher_->deadline().count()));
+   }
+   for(unsigned int ii=0; ii<Worker::C_S_PHASES; ++ii) {
+      const lcr::LatencyHistogram& latency = latencies_[ii];
+      if(latency.count()) {
+         auto us = [](unsigned long long ns) { return ns / 1000.0; };
+         LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Latency %-8s [requests:%llu] [avg:%.1f us] [p50:%.1f us] [p90:%.1f us] [p99:%.1f us] [p99.9:%.1f us] [max:%.1f us]",
+            Worker::phase_name(static_cast<Worker::Phase>(ii)), latency.count(), us(latency.total()) / latency.count(), us(latency.percentile(0.5)),
+            us(latency.percentile(0.9)), us(latency.percentile(0.99)), us(latency.percentile(0.999)), us(latency.max()));
+      }
+   }
+   std::size_t used = used_resource_.bytes(), reserved = reserved_resource_.bytes();
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Cache memory: [in use:%zu bytes] [pool:%zu bytes] [fragmentation:%.2f%%] [allocations: pool %llu, system %llu] [rss:%zu kB]",
+      used, reserved, reserved ? 100.0 * (reserved - used) / reserved : 0.0, used_resource_.allocations(), reserved_resource_.allocations(), resident_memory() / 1024);
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER]-----------------------------------------------------------------------------");
+}
+
+// Function that appends a metric in the Prometheus text format: its description, its type and its value
+static void append_metric(std::string& out, const char * name, const char * type, const char * help, double value)
+{
+   char text[256];
+   snprintf(text, sizeof(text), "# HELP %s %s\n# TYPE %s %s\n%s %.15g\n", name, help, name, type, name, value);
+   out += text;
+}
+
+// The upper bounds of the buckets of the exported latency histograms, in nanoseconds: from 10 us to 10 s
+static const unsigned long long C_S_LATENCY_BOUNDS[] = {
+   10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000, 50000000,
+   100000000, 250000000, 500000000, 1000000000, 2500000000, 5000000000, 10000000000
+};
+
+void Server::exportMetrics(std::string& out) const
+{
+   append_metric(out, "ncs_requests_total", "counter", "Requests accepted and given to a worker.", workers_.load(std::memory_order_relaxed));
+   append_metric(out, "ncs_request_errors_total", "counter", "Requests that finished with an error.", errors_.load(std::memory_order_relaxed));
+   append_metric(out, "ncs_unattended_requests_total", "counter", "Connections closed because no worker could be started.",
+      unattended_requests_.load(std::memory_order_relaxed));
+   append_metric(out, "ncs_requests_in_flight", "gauge", "Requests being processed by a worker.", in_flight_.load(std::memory_order_relaxed));
+   // The connections waiting to be accepted: for a listening socket, the kernel reports them as unacknowledged
+   struct tcp_info info;
+   socklen_t length = sizeof(info);
+   bool queried;
+   {
+      std::lock_guard<std::mutex> guard(sockfd_mutex_);
+      queried = (sockfd_!=-1 && getsockopt(sockfd_, IPPROTO_TCP, TCP_INFO, &info, &length)==0);
+   }
+   if(queried) {
+      append_metric(out, "ncs_accept_queue_depth", "gauge", "Connections waiting to be accepted.", info.tcpi_unacked);
+   }
+
+   // The cache, read without its lock
+   unsigned long long hits = cache_.hits(), faults = cache_.faults();
+   append_metric(out, "ncs_cache_entries", "gauge", "Entries in the cache.", cache_.entries());
+   append_metric(out, "ncs_cache_capacity", "gauge", "Maximum number of entries in the cache.", cache_.capacity());
+   append_metric(out, "ncs_cache_hits_total", "counter", "Cache lookups that found their key.", hits);
+   append_metric(out, "ncs_cache_misses_total", "counter", "Cache lookups that did not find their key.", faults);
+   append_metric(out, "ncs_cache_hit_ratio", "gauge", "Ratio of cache lookups that found their key since the start.", (hits + faults) ? static_cast<double>(hits) / (hits + faults) : 0.0);
+   append_metric(out, "ncs_cache_erased_total", "counter", "Cache entries evicted, expired or cleared.", cache_.erased());
+   append_metric(out, "ncs_cache_overwritten_total", "counter", "Cache entries overwritten.", cache_.overwritten());
+   append_metric(out, "ncs_cache_memory_bytes", "gauge", "Memory used by the cache entries.", used_resource_.bytes());
+   append_metric(out, "ncs_cache_pool_bytes", "gauge", "Memory kept from the system by the pool of the cache entries.", reserved_resource_.bytes());
+   if(prefixes_) {
+      append_metric(out, "ncs_prefix_cache_hits_total", "counter", "Texts that resumed hashing from a cached prefix.", prefixes_->hits());
+      append_metric(out, "ncs_prefix_cache_misses_total", "counter", "Texts hashed from the start.", prefixes_->misses());
+      append_metric(out, "ncs_prefix_cache_saved_bytes_total", "counter", "Bytes not hashed thanks to the cached prefixes.", prefixes_->bytesSaved());
+   }
+   if(batcher_) {
+      append_metric(out, "ncs_hash_batch_queue_depth", "gauge", "Texts waiting for their hash batch.", batcher_->queued());
+      append_metric(out, "ncs_hash_batches_total", "counter", "Hash batches hashed.", batcher_->batches());
+      append_metric(out, "ncs_hash_batch_texts_total", "counter", "Texts hashed in batches.", batcher_->requests());
+   }
+
+   // The logger
+   append_metric(out, "ncs_logger_dropped_total", "counter", "Log records lost because the logger was full.", logger_.dropped());
+   append_metric(out, "ncs_logger_queue_depth", "gauge", "Log records waiting to be written.", logger_.queued());
+
+   // The latencies of the request phases, as cumulative buckets
+   out += "# HELP ncs_request_phase_seconds Time spent by the requests in each phase.\n# TYPE ncs_request_phase_seconds histogram\n";
+   char text[256];
+   for(unsigned int ii=0; ii<Worker::C_S_PHASES; ++ii) {
+      const lcr::LatencyHistogram& latency = latencies_[ii];
+      const char * phase = Worker::phase_name(static_cast<Worker::Phase>(ii));
+      unsigned long long count = 0;
+      unsigned int bound = 0, bounds = sizeof(C_S_LATENCY_BOUNDS) / sizeof(C_S_LATENCY_BOUNDS[0]);
+      for(unsigned int bucket=0; bucket<=lcr::LatencyHistogram::C_S_BUCKETS; ++bucket) {
+         // The buckets are cumulative, so a bound is written before the first bucket above it
+         while(bound<bounds && (bucket==lcr::LatencyHistogram::C_S_BUCKETS || lcr::LatencyHistogram::highest(bucket)>C_S_LATENCY_BOUNDS[bound])) {
+            snprintf(text, sizeof(text), "ncs_request_phase_seconds_bucket{phase=\"%s\",le=\"%g\"} %llu\n", phase, C_S_LATENCY_BOUNDS[bound] / 1e9, count);
+            out += text;
+            ++bound;
+         }
+         if(bucket<lcr::LatencyHistogram::C_S_BUCKETS) {
+            count += latency.count(bucket);
+         }
+      }
+      snprintf(text, sizeof(text), "ncs_request_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n"
+                                   "ncs_request_phase_seconds_sum{phase=\"%s\"} %.9f\n"
+                                   "ncs_request_phase_seconds_count{phase=\"%s\"} %llu\n", phase, count, phase, latency.total() / 1e9, phase, count);
+      out += text;
+   }
+}
+
+void Server::collect_(const Worker& worker)
+{
+   if(worker.error()) {
+      ++errors_;
+   }
+   hashed_ += worker.hashed();
+   hashing_time_ += worker.hashing_time();
+   streamed_ += worker.streamed();
+   streaming_time_ += worker.streaming_time();
+   for(unsigned int ii=0; ii<Worker::C_S_PHASES; ++ii) {
+      Worker::Phase phase = static_cast<Worker::Phase>(ii);
+      if(worker.measured(phase)) {
+         latencies_[ii].record(worker.latency(phase).count());
+      }
    }
-   logger_.trace(LOG_LEVEL_1, "[SERVER] Unattended input requests: %llu", unattended_requests_);
-   logger_.trace(LOG_LEVEL_1, "[SERVER]-----------------------------------------------------------------------------");
 }
 
 void Server::update_tasks_()
@@ -176,10 +355,8 @@ void Server::update_tasks_()
       auto current = it++;
       if(future_is_ready(current->future)) {
          const auto& worker = *(current->worker);
-         logger_.trace(LOG_LEVEL_5, "[SERVER] Finishing worker #%u (%u tasks left)", worker.id(), tasks_.size());
-         if(worker.error()) {
-            ++errors_;
-         }
+         LCR_TRACE(logger_, LOG_LEVEL_5, "[SERVER] Finishing worker #%u (%u tasks left)", worker.id(), tasks_.size());
+         collect_(worker);
          tasks_.erase(current);
       }
    }
@@ -187,22 +364,20 @@ void Server::update_tasks_()
 
 void Server::wait_for_tasks_()
 {
-   logger_.trace(LOG_LEVEL_1, "[SERVER] Waiting for pending tasks... (%u tasks)", tasks_.size());
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Waiting for pending tasks... (%u tasks)", tasks_.size());
    for(auto it=tasks_.begin(); it!=tasks_.end(); ) {
       auto current = it++;
       const auto& worker = *(current->worker);
-      logger_.trace(LOG_LEVEL_4, "[SERVER] Waiting for worker #%u (%u tasks left)", worker.id(), tasks_.size());
+      LCR_TRACE(logger_, LOG_LEVEL_4, "[SERVER] Waiting for worker #%u (%u tasks left)", worker.id(), tasks_.size());
       current->future.wait();
-      if(worker.error()) {
-         ++errors_;
-      }
+      collect_(worker);
       tasks_.erase(current);
    }
 }
 
 void Server::cancel_tasks_()
 {
-   logger_.trace(LOG_LEVEL_1, "[SERVER] Canceling pending tasks... (%u tasks)", tasks_.size());
+   LCR_TRACE(logger_, LOG_LEVEL_1, "[SERVER] Canceling pending tasks... (%u tasks)", tasks_.size());
    for(auto it=tasks_.begin(); it!=tasks_.end(); ++it) {
       const auto& worker = *(it->worker);
       worker.cancel();
@@ -210,11 +385,9 @@ void Server::cancel_tasks_()
    for(auto it=tasks_.begin(); it!=tasks_.end(); ) {
       auto current = it++;
       const auto& worker = *(current->worker);
-      logger_.trace(LOG_LEVEL_4, "[SERVER] Canceling worker #%u (%u tasks left)", worker.id(), tasks_.size());
+      LCR_TRACE(logger_, LOG_LEVEL_4, "[SERVER] Canceling worker #%u (%u tasks left)", worker.id(), tasks_.size());
       current->future.wait();
-      if(worker.error()) {
-         ++errors_;
-      }
+      collect_(worker);
       tasks_.erase(current);
    }
 }
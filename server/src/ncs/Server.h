@@ -10,12 +10,20 @@
 
 // Stl
 #include <list>
+#include <mutex>
+#include <atomic>
+#include <string>
 #include <future>
 #include <memory>
+#include <memory_resource>
 
 // Components
 #include "Worker.h"
 
+// lib locar
+#include "lcr/MemoryResource.hpp"
+#include "lcr/LatencyHistogram.hpp"
+
 
 namespace ncs
 {
@@ -25,9 +33,13 @@ class Server
 {
    public:
       // The constructor receives as parameters the port number where it listens for requests,
-      // the maximum size of the cache where it stores the results and a timeout for the automatic cache discard functionality.
+      // the maximum size of the cache where it stores the results, a timeout for the automatic cache discard functionality
+      // the root directory of the files that clients can hash (empty to disable file requests), the memory
+      // for the MD5 states of common text prefixes (zero to disable the prefix cache) and the deadline of the
+      // batches of texts hashed together (zero to hash every text on its own).
       // It also receives a reference to the logger to show traces of its operation.
-      Server(unsigned int port, unsigned int cache_capacity, unsigned int cache_timeout, lcr::Logger& logger);
+      Server(unsigned int port, unsigned int cache_capacity, unsigned int cache_timeout, const std::string& root, std::size_t prefix_memory,
+             std::chrono::microseconds batch_deadline, lcr::Logger& logger);
       virtual ~Server();
 
    public:
@@ -57,6 +69,10 @@ class Server
       // This method requests the server to print the internal statistics
       void printStatistics() const;
 
+      // This method appends the internal statistics in the Prometheus text format. It reads counters updated without
+      // locks, so it can be called from any thread, at any time, without taking the cache lock.
+      void exportMetrics(std::string& out) const;
+
    private:
       // Private method that update the list of active tasks according to its status 
       void update_tasks_();
@@ -64,6 +80,8 @@ class Server
       void wait_for_tasks_();
       // Private method that cance all pending task to finish as soon as possible
       void cancel_tasks_();
+      // Private method that accumulates the statistics of a finished worker
+      void collect_(const Worker& worker);
 
    private: // Non-copyable.
       Server(const Server&) = delete;
@@ -82,11 +100,28 @@ class Server
       // The server port number
       int port_;
 
-      // The server socket decriptor
+      // The server socket decriptor (-1 when closed), read by the metrics to get the connections waiting to be accepted.
+      // It is closed under its mutex, so a scrape never queries a closed descriptor, or one reused by another socket
       int sockfd_;
+      mutable std::mutex sockfd_mutex_;
+
+      // The root directory of the files that clients can hash
+      std::string root_;
+
+      // The memory resources for the cache entries: a pool of size classes recycled on eviction,
+      // wrapped to measure the memory used by the entries and the memory the pool keeps from the system
+      lcr::StatisticsResource reserved_resource_;
+      std::pmr::unsynchronized_pool_resource pool_resource_;
+      lcr::StatisticsResource used_resource_;
 
       // The server cache, parametrized as: KEY(text) => VALUE(digest)
-      lcr::Cache<std::string, std::string> cache_;
+      DigestCache cache_;
+
+      // The MD5 states after common text prefixes, shared by the workers (optional)
+      std::unique_ptr<lcr::MD5PrefixCache> prefixes_;
+
+      // The hashing stage that batches the texts of the workers (optional)
+      std::unique_ptr<lcr::HashBatcher> batcher_;
 
    private: // Utilities to keep track of threads status
       // This is the sequence of unique identifiers for workers
@@ -102,10 +137,16 @@ class Server
       // This is the list of active tasks
       std::list<Task> tasks_;
 
-   private: // Utilities for statistics purposes
-      unsigned long long workers_;   // Total number of created workers
-      unsigned long long errors_;    // The number of errors reported by workers 
-      unsigned long long unattended_requests_;    // The number of unattended request
+   private: // Utilities for statistics purposes (the atomic ones are also read by the metrics)
+      std::atomic<unsigned long long> workers_;   // Total number of created workers
+      std::atomic<unsigned long long> errors_;    // The number of errors reported by workers 
+      std::atomic<unsigned long long> unattended_requests_;    // The number of unattended request
+      std::atomic<unsigned int> in_flight_;       // The number of workers processing a request
+      unsigned long long hashed_;    // Total number of bytes hashed by workers
+      std::chrono::nanoseconds hashing_time_;     // Time spent by workers in the MD5 code
+      unsigned long long streamed_;  // Total number of bytes of streamed bodies
+      std::chrono::nanoseconds streaming_time_;   // Time spent by workers receiving and hashing streamed bodies
+      lcr::LatencyHistogram latencies_[Worker::C_S_PHASES]; // Latencies of the request phases of the finished workers
 };
 
 } // namespace ncs
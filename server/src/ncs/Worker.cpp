@@ -7,17 +7,25 @@
 
 // Stl
 #include <thread>
-#include <sstream>
+#include <cerrno>
+#include <cstring>
 #include <algorithm>
 
 // sockets
 #include <sys/socket.h>
 #include <unistd.h>
 #include <poll.h>
+// files
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 
 // lib locar
 #include "lcr/md5.h"
+#include "lcr/MD5Tree.h"
 #include "lcr/String.hpp"
+#include "lcr/LogLimiter.hpp"
 #include "lcr/Exceptions.hpp"
 
 
@@ -25,47 +33,132 @@
 namespace ncs
 {
 
-Worker::Worker(unsigned int id, int sockfd, const sockaddr_in& addr, lcr::Cache<std::string, std::string>& cache, lcr::Logger& logger)
+// The size of the reception buffer, which is also the maximum length of a request line
+static const std::size_t C_S_BUFFER_SIZE = 64 * 1024;
+
+// The size of the chunks of a file read at once by a tree request: whole leaves, several for every hashing thread
+static const std::size_t C_S_TREE_CHUNK = 16 * lcr::MD5Tree::C_S_DEFAULT_LEAF_SIZE;
+
+// The prefix of the tree hash responses, so they are never taken for plain MD5 digests
+static const char C_S_TREE_PREFIX[] = "md5tree:";
+
+// The warnings written per second by each call site: clients can trigger them at will
+static const unsigned int C_S_WARNINGS_PER_SECOND = 10;
+
+
+// The longest delay that a request can ask for, in milliseconds: an hour
+static const unsigned long long C_S_MAX_DELAY = 3600 * 1000;
+
+
+// Function that parses a token of digits into a number no greater than 'max'. Returns false if the token has other
+// chars or the number is out of range, where std::stoull would throw
+static bool to_number(const std::string& token, unsigned long long max, unsigned long long& value)
+{
+   if(!lcr::string::is_number(token)) {
+      return false;
+   }
+   errno = 0;
+   value = std::strtoull(token.c_str(), nullptr, 10);
+   return errno!=ERANGE && value<=max;
+}
+
+// Function that returns true if a canonical path is the root directory or is under it
+static bool under_root(const char * path, const std::string& root)
+{
+   return !std::strncmp(path, root.c_str(), root.size()) && (path[root.size()]=='/' || root=="/");
+}
+
+
+Worker::Worker(unsigned int id, int sockfd, const sockaddr_in& addr, DigestCache& cache, const std::string& root,
+               lcr::MD5PrefixCache* prefixes, lcr::HashBatcher* batcher, lcr::Logger& logger)
    : logger_(logger)
    , addr_()
    , sockfd_(sockfd)
    , id_(id)
    , cache_(cache)
+   , root_(root)
+   , prefixes_(prefixes)
+   , batcher_(batcher)
    , delay_()
    , timeout_(1000) // milliseconds => 1s
+   , buffer_(C_S_BUFFER_SIZE)
    , text_()
    , digest_()
+   , engine_(&lcr::DigestEngine::md5())
+   , raw_()
+   , tree_()
    , error_()
    , ec_()
+   , hashed_()
+   , streamed_()
+   , hashing_time_()
+   , streaming_time_()
+   , accepted_(std::chrono::steady_clock::now())
+   , latencies_()
+   , measured_()
    , cancelled_()
 {
-   logger_.trace(LOG_LEVEL_6, "[WORKER] Worker #%u is ready", id_);
+   LCR_TRACE(logger_, LOG_LEVEL_6, "[WORKER] Worker #%u is ready", id_);
 }
 
 Worker::~Worker()
 {
-   logger_.trace(LOG_LEVEL_6, "[WORKER] Worker #%u has finished", id_);
+   LCR_TRACE(logger_, LOG_LEVEL_6, "[WORKER] Worker #%u has finished", id_);
+}
+
+
+const char * Worker::phase_name(Phase phase)
+{
+   static const char * const names[C_S_PHASES] = { "accept", "receive", "parse", "lookup", "delay", "hash", "send", "total" };
+   return names[static_cast<unsigned int>(phase)];
 }
 
 
 void Worker::exec()
 {
-   char buffer[256];
-   // The worker receives a request from a client, process it and send the response back
-   int bytes = async_recv_(buffer, timeout_);
-   int bytes_received = bytes;
-   while(!error_ && buffer[bytes_received]!='\n' && bytes>0) {
-      bytes = async_recv_(buffer+bytes_received, timeout_);
+   char* buffer = buffer_.data();
+   // The worker receives a request line from a client, process it and send the response back.
+   // The line ends with '\n', or when the client stops sending; anything after it is the start of a body.
+   std::size_t bytes_received = 0;
+   char* eol = nullptr;
+   auto first_byte = accepted_;
+   while(!error_ && bytes_received<buffer_.size()-1) {
+      int bytes = async_recv_(buffer+bytes_received, buffer_.size()-1-bytes_received, timeout_);
+      if(bytes<=0) {
+         break;
+      }
+      if(!bytes_received) {
+         first_byte = measure_(Phase::accept, accepted_);
+      }
+      eol = static_cast<char*>(memchr(buffer+bytes_received, '\n', bytes));
       bytes_received += bytes;
+      if(eol) {
+         break;
+      }
    }
-   if(!error_ && process_request_(buffer, bytes_received)) {
+   if(bytes_received) {
+      measure_(Phase::receive, first_byte);
+   }
+   std::size_t length = eol ? eol - buffer : bytes_received;
+   if(!eol && bytes_received==buffer_.size()-1) {
+      error_ = true;
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Request line too long (more than %zu bytes)", id_, bytes_received);
+   }
+   buffer[length] = '\0';
+   if(length && buffer[length-1]=='\r') {
+      buffer[length-1] = '\0';
+   }
+   if(!error_ && process_request_(buffer, length, bytes_received)) {
       send_response_();
+      if(!error_) { // Only the requests answered count for the total
+         measure_(Phase::total, accepted_);
+      }
    }
    close(sockfd_);
 }
 
 
-int Worker::async_recv_(char* buffer, int timeout)
+int Worker::async_recv_(char* buffer, std::size_t size, int timeout)
 {
    int bytes_received = 0;
 
@@ -73,99 +166,415 @@ int Worker::async_recv_(char* buffer, int timeout)
    fds[0].fd = sockfd_;
    fds[0].events = POLLIN;
 
-   int nfds = poll(fds, 1, 1000);
+   int nfds = poll(fds, 1, timeout);
    if(nfds==-1) {
       if(errno!=EINTR) { // If not is an interrupt call
          ec_ = errno;
          error_ = true;
-         logger_.error(LOG_WARNING, "[WORKER] ID#%u - Failed while polling in the socket (%d)", id_, ec_);
+         LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Failed while polling in the socket (%d)", id_, ec_);
       }
    }
    else if(nfds>0) {
-      if(fds[0].revents & POLLIN) { // Data received
-         bytes_received = recv(sockfd_, buffer, (sizeof(buffer)-1), 0);
+      if(fds[0].revents & (POLLIN | POLLHUP)) { // Data received
+         bytes_received = recv(sockfd_, buffer, size, 0);
          if(bytes_received==-1) {
             ec_ = errno;
             error_ = true;
-            logger_.trace(LOG_WARNING, "[WORKER] ID#%u - Reception error: (%d)", id_, ec_);
+            LCR_TRACE(logger_, LOG_WARNING, "[WORKER] ID#%u - Reception error: (%d)", id_, ec_);
          }
       }
    }
    else { // nfds == 0
       // Nothing to do: the system call timed out before any file descriptors became read
    }
-   if(!error_ && bytes_received>0) {
-      if(buffer[bytes_received-1]=='\n') {
-         buffer[bytes_received - 1] = '\0';
-      }
-      buffer[bytes_received] = '\0';
-   }
    return bytes_received;
 }
 
 
-bool Worker::process_request_(char* buffer, int bytes_received)
+bool Worker::process_request_(char* buffer, std::size_t length, std::size_t bytes_received)
 {
-   logger_.trace(LOG_LEVEL_3, "[WORKER] ID#%u - Message received => '%s'", id_, buffer);
+   LCR_TRACE(logger_, LOG_LEVEL_3, "[WORKER] ID#%u - Message received => '%s'", id_, buffer);
    const std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+   auto parsing = std::chrono::steady_clock::now();
    auto tokens = lcr::string::split(buffer);
-   if(tokens.size()!=3) { // Invalid request formati: 'command text delay'
-      error_ = true;
-      std::ostringstream os;
-      if(bytes_received == 0) {
-         os << "<empty>";
-      }
-      else for(unsigned int ii=0; ii<bytes_received; ++ii) {
-         os << "[" << (unsigned short)buffer[ii] << "] ";
-      }
-      logger_.error(LOG_WARNING, "[WORKER] ID#%u - Invalid message format: '%s' - tokens: %u - char buffer: %s (%d bytes received)",
-         id_, buffer, tokens.size(), os.str().c_str(), bytes_received);
-   }
-   else { // OK  =>  tokens.size() = 3 
-      lcr::string::to_lower(tokens[0]);
-      text_ = tokens[1];
-      bool found = cache_.get(text_, digest_);
-      if(!found) {
-         delay_ = std::chrono::milliseconds(std::stoi(tokens[2]));
-         if(tokens[0]=="get" && lcr::string::is_number(tokens[2])) {
-            while((std::chrono::system_clock::now() < (start + delay_)) && !cancelled_) {
-               std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
-            if(!cancelled_) {
-               digest_ = lcr::md5(text_);
-               cache_.set(text_, digest_);
-               logger_.trace(LOG_LEVEL_5, "[WORKER] ID#%u - Message proccesed in %d ms: '%s' =digest=> '%s'",
-                     id_, (int)delay_.count(), text_.c_str(), digest_.c_str());
+   bool parsed = parse_options_(tokens);
+   measure_(Phase::parse, parsing);
+   if(!parsed) { // Invalid request format: 'command text delay [algorithm] [raw]'
+      error_ = true; // The dump of the bytes is only built when the warning is written
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Invalid message format: '%s' - tokens: %zu - char buffer: %s (%zu bytes received)",
+         id_, buffer, tokens.size(), lcr::string::dump_bytes(buffer, length).c_str(), bytes_received);
+      return false;
+   }
+   lcr::string::to_lower(tokens[0]);
+   if((tokens[0]=="hash" || tokens[0]=="tree") && engine_!=&lcr::DigestEngine::md5()) {
+      error_ = true; // Streamed bodies and tree hashes are MD5 only
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - The '%s' command does not support %s", id_, tokens[0].c_str(), engine_->name());
+      return false;
+   }
+   if(tokens[0]=="hash") { // Streamed body: 'hash length delay [raw]'
+      std::size_t body = std::min(length + 1, bytes_received);
+      return process_hash_(tokens, buffer + body, bytes_received - body);
+   }
+   if(tokens[0]=="file" || tokens[0]=="tree") { // File under the root directory: 'file path delay [algorithm] [raw]', or its tree hash: 'tree path delay [raw]'
+      tree_ = (tokens[0]=="tree");
+      return process_file_(tokens);
+   }
+   // OK  =>  'get text delay [algorithm] [raw]'. Every algorithm but MD5 has its own namespace in the cache: texts never contain spaces
+   text_.clear();
+   if(engine_!=&lcr::DigestEngine::md5()) {
+      text_ = engine_->name();
+      text_ += " ";
+   }
+   text_ += tokens[1];
+   auto lookup = std::chrono::steady_clock::now();
+   bool found = cache_.get(text_, digest_);
+   measure_(Phase::lookup, lookup);
+   if(!found) {
+      unsigned long long delay = 0;
+      if(tokens[0]=="get" && to_number(tokens[2], C_S_MAX_DELAY, delay)) {
+         delay_ = std::chrono::milliseconds(delay);
+         if(wait_delay_(start)) {
+            const std::string& text = tokens[1];
+            auto hashing = std::chrono::steady_clock::now();
+            if(batcher_ && !prefixes_ && engine_==&lcr::DigestEngine::md5()) {
+               // Hashed in a batch with the texts of other workers: the batcher accounts for the hashing time and bytes
+               digest_ = batcher_->digest(text.data(), text.size());
             }
             else {
-               error_ = true; // Worker has been canceled 
+               if(engine_!=&lcr::DigestEngine::md5()) {
+                  digest_ = engine_->digest(text.data(), text.size());
+               }
+               else if(prefixes_) { // Resumes from the longest cached prefix
+                  digest_ = prefixes_->digest(text.data(), text.size());
+               }
+               else {
+                  digest_ = lcr::md5_digest(text.data(), text.size());
+               }
+               hashing_time_ += std::chrono::steady_clock::now() - hashing;
+               hashed_ += text.size();
             }
+            measure_(Phase::hash, hashing); // Including the wait for the batch
+            cache_.set(text_, digest_);
+            LCR_TRACE(logger_, LOG_LEVEL_5, "[WORKER] ID#%u - Message proccesed in %d ms: '%s' =digest=> '%s'",
+                  id_, (int)delay_.count(), text_.c_str(), lcr::to_string(digest_).c_str());
          }
          else {
-           error_ = true; // Invalid command or invalid delay
-           logger_.error(LOG_WARNING, "[WORKER] ID#%u - Invalid message format: '%s'", id_, buffer);
+            error_ = true; // Worker has been canceled 
          }
       }
+      else {
+        error_ = true; // Invalid command or invalid delay
+        LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Invalid message format: '%s'", id_, buffer);
+      }
    }
    return !error_;
 }
 
 
+// Private method that parses the optional tokens after 'command text delay': the digest algorithm (md5, sha1 or sha256)
+// and the response format (raw), in any order. Returns false if there are too many or too few tokens, or an unknown one.
+bool Worker::parse_options_(std::vector<std::string>& tokens)
+{
+   if(tokens.size()<3 || tokens.size()>5) {
+      return false;
+   }
+   bool algorithm = false;
+   for(std::size_t ii=3; ii<tokens.size(); ++ii) {
+      lcr::string::to_lower(tokens[ii]);
+      const lcr::DigestEngine* engine = lcr::DigestEngine::find(tokens[ii]);
+      if(tokens[ii]=="raw" && !raw_) {
+         raw_ = true;
+      }
+      else if(engine && !algorithm) {
+         engine_ = engine;
+         algorithm = true;
+      }
+      else {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+// Private method that processes a 'hash length delay' request: the body is hashed as it arrives, with constant memory,
+// and then the digest is looked up in the cache, so a body whose content was already hashed does not wait for the delay
+bool Worker::process_hash_(const std::vector<std::string>& tokens, const char* body, std::size_t bytes)
+{
+   const std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+   unsigned long long length = 0, delay = 0;
+   if(!to_number(tokens[1], ULLONG_MAX, length) || !to_number(tokens[2], C_S_MAX_DELAY, delay)) {
+      error_ = true; // Invalid length or invalid delay
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Invalid message format: '%s %s %s'", id_, tokens[0].c_str(), tokens[1].c_str(), tokens[2].c_str());
+      return false;
+   }
+   delay_ = std::chrono::milliseconds(delay);
+   if(!hash_body_(length, body, bytes)) {
+      return false;
+   }
+   // The content digest is the cache key, in its own namespace: texts never contain spaces
+   char hex[32];
+   digest_.hex(hex);
+   text_ = "hash ";
+   text_.append(hex, sizeof(hex));
+   lcr::DigestValue cached;
+   auto lookup = std::chrono::steady_clock::now();
+   bool found = cache_.get(text_, cached);
+   measure_(Phase::lookup, lookup);
+   if(!found) {
+      if(!wait_delay_(start)) {
+         error_ = true; // Worker has been canceled
+         return false;
+      }
+      cache_.set(text_, digest_);
+   }
+   LCR_TRACE(logger_, LOG_LEVEL_5, "[WORKER] ID#%u - Body of %llu bytes proccesed: =digest=> '%.32s'", id_, length, hex);
+   return true;
+}
+
+
+// Private method that hashes a body of the given length: first the bytes already received after the request line,
+// then the rest in chunks of the reception buffer as they arrive
+bool Worker::hash_body_(unsigned long long length, const char* body, std::size_t bytes)
+{
+   auto start = std::chrono::steady_clock::now();
+   lcr::MD5 md5;
+   auto update = [&](const char* data, std::size_t size) {
+      auto hashing = std::chrono::steady_clock::now();
+      md5.update(data, size);
+      hashing_time_ += measure_(Phase::hash, hashing) - hashing;
+      hashed_ += size;
+   };
+   unsigned long long pending = length;
+   std::size_t first = static_cast<std::size_t>(std::min<unsigned long long>(bytes, pending));
+   update(body, first);
+   pending -= first;
+   while(pending && !error_ && !cancelled_) {
+      std::size_t size = static_cast<std::size_t>(std::min<unsigned long long>(buffer_.size(), pending));
+      int bytes = async_recv_(buffer_.data(), size, timeout_);
+      if(bytes<=0) {
+         if(!error_) {
+            error_ = true;
+            LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Incomplete body: %llu of %llu bytes received", id_, length - pending, length);
+         }
+         break;
+      }
+      update(buffer_.data(), bytes);
+      pending -= bytes;
+   }
+   streaming_time_ += std::chrono::steady_clock::now() - start;
+   streamed_ += length - pending;
+   if(pending) {
+      error_ = true; // Reception error or worker canceled
+      return false;
+   }
+   digest_ = md5.finalize().binarydigest();
+   return true;
+}
+
+
+// Private method that processes a 'file path delay' or a 'tree path delay' request. The path is relative to the root directory
+// and must not leave it. The file is read in chunks and hashed, and cached by kind of digest, path, modification time and size,
+// so unchanged files are answered from the cache.
+bool Worker::process_file_(const std::vector<std::string>& tokens)
+{
+   const std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+   if(root_.empty()) {
+      error_ = true;
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - File requests are disabled: no root directory configured", id_);
+      return false;
+   }
+   unsigned long long delay = 0;
+   if(!to_number(tokens[2], C_S_MAX_DELAY, delay)) {
+      error_ = true; // Invalid delay
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Invalid message format: '%s %s %s'", id_, tokens[0].c_str(), tokens[1].c_str(), tokens[2].c_str());
+      return false;
+   }
+   delay_ = std::chrono::milliseconds(delay);
+   // Resolve the path (symbolic links and '..' included) and check that it stays under the root directory
+   char resolved[PATH_MAX];
+   std::string path = root_ + "/" + tokens[1];
+   if(!realpath(path.c_str(), resolved) || !under_root(resolved, root_)) {
+      error_ = true;
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Invalid file: '%s'", id_, tokens[1].c_str());
+      return false;
+   }
+   // The open does not block (a FIFO would wait for a writer) nor follow a symbolic link swapped in after the check,
+   // and the file opened is checked again, as any directory of the path may have been swapped too
+   int fd = open(resolved, O_RDONLY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC);
+   struct stat st;
+   char opened[PATH_MAX];
+   ssize_t length = -1;
+   if(fd!=-1) {
+      std::string link = "/proc/self/fd/" + std::to_string(fd);
+      length = readlink(link.c_str(), opened, sizeof(opened) - 1);
+      opened[std::max<ssize_t>(length, 0)] = '\0';
+   }
+   if(fd==-1 || fstat(fd, &st)==-1) {
+      ec_ = errno;
+      error_ = true;
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Unable to open the file '%s' (%d)", id_, resolved, ec_);
+   }
+   else if(!S_ISREG(st.st_mode)) {
+      error_ = true;
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Not a regular file: '%s'", id_, resolved);
+   }
+   else if(length<=0 || std::strcmp(opened, resolved) || !under_root(opened, root_)) {
+      error_ = true;
+      LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - The file '%s' has changed while it was opened", id_, resolved);
+   }
+   if(error_) {
+      if(fd!=-1) {
+         close(fd);
+      }
+      return false;
+   }
+   // The cache key, in its own namespace (and in the namespace of the algorithm): texts never contain spaces
+   text_.clear();
+   if(engine_!=&lcr::DigestEngine::md5()) {
+      text_ = engine_->name();
+      text_ += " ";
+   }
+   text_ += tree_ ? "tree " : "file ";
+   text_ += resolved;
+   text_ += " " + std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec) + " " + std::to_string(st.st_size);
+   auto lookup = std::chrono::steady_clock::now();
+   bool found = cache_.get(text_, digest_);
+   measure_(Phase::lookup, lookup);
+   if(!found) {
+      if(hash_file_(fd, static_cast<std::size_t>(st.st_size)) && wait_delay_(start)) {
+         cache_.set(text_, digest_);
+      }
+      else {
+         error_ = true; // Read error or worker canceled
+      }
+   }
+   close(fd);
+   if(!error_) {
+      LCR_TRACE(logger_, LOG_LEVEL_5, "[WORKER] ID#%u - File proccesed: '%s' =digest=> '%s'", id_, text_.c_str(), lcr::to_string(digest_).c_str());
+   }
+   return !error_;
+}
+
+
+// Private method that hashes a whole file read with pread, never from a mapping: a file truncated while it is hashed
+// (a log rotated, an editor saving) would raise a SIGBUS, killing the server. Files that fit in the reception buffer
+// are hashed at once, larger ones in pieces through the buffer or, for tree requests, in chunks of whole leaves, whose
+// leaves are hashed in parallel by all the CPUs. Returns false if the file can not be read in full or the worker is
+// cancelled.
+bool Worker::hash_file_(int fd, std::size_t size)
+{
+   static const lcr::MD5Tree tree;
+   auto hashing = std::chrono::steady_clock::now();
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+   if(size<=buffer_.size()) {
+      if(!read_file_(fd, buffer_.data(), size, 0)) {
+         return false;
+      }
+      digest_ = tree_ ? lcr::DigestValue(tree.digest(buffer_.data(), size)) : engine_->digest(buffer_.data(), size);
+   }
+   else if(tree_) {
+      std::vector<lcr::MD5::Digest> digests((size + tree.leafSize() - 1) / tree.leafSize());
+      std::vector<char> chunk(std::min(size, C_S_TREE_CHUNK));
+      for(std::size_t offset=0; offset<size; offset+=chunk.size()) {
+         std::size_t bytes = std::min(chunk.size(), size - offset);
+         if(cancelled_ || !read_file_(fd, chunk.data(), bytes, offset)) {
+            return false;
+         }
+         tree.leaves(chunk.data(), bytes, digests.data() + offset / tree.leafSize());
+      }
+      digest_ = tree.root(digests.data(), digests.size());
+   }
+   else {
+      std::unique_ptr<lcr::DigestStream> stream = engine_->stream();
+      for(std::size_t offset=0; offset<size; offset+=buffer_.size()) {
+         std::size_t bytes = std::min(buffer_.size(), size - offset);
+         if(cancelled_ || !read_file_(fd, buffer_.data(), bytes, offset)) {
+            return false;
+         }
+         stream->update(buffer_.data(), bytes);
+      }
+      digest_ = stream->finalize();
+   }
+   hashing_time_ += measure_(Phase::hash, hashing) - hashing;
+   hashed_ += size;
+   return true;
+}
+
+
+// Private method that reads a part of a file: returns false if it ends before (it has been truncated) or on a read error
+bool Worker::read_file_(int fd, char* data, std::size_t size, std::size_t offset)
+{
+   std::size_t bytes = 0;
+   while(bytes<size) {
+      ssize_t n = pread(fd, data + bytes, size - bytes, offset + bytes);
+      if(n==-1 && errno==EINTR) {
+         continue;
+      }
+      if(n<=0) {
+         ec_ = (n==-1) ? errno : 0;
+         LCR_ERROR_LIMITED(logger_, C_S_WARNINGS_PER_SECOND, LOG_WARNING, "[WORKER] ID#%u - Unable to read the file (%d): %s", id_, ec_,
+                           (n==0) ? "it has been truncated" : "read error");
+         return false;
+      }
+      bytes += n;
+   }
+   return true;
+}
+
+
+// Private method that simulates the processing time: returns false if the worker is cancelled while waiting
+bool Worker::wait_delay_(const std::chrono::time_point<std::chrono::system_clock>& start)
+{
+   auto waiting = std::chrono::steady_clock::now();
+   while((std::chrono::system_clock::now() < (start + delay_)) && !cancelled_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+   }
+   measure_(Phase::delay, waiting);
+   return !cancelled_;
+}
+
+
 void Worker::send_response_()
 {
-   // Send the response
-   int bytes_sent = send(sockfd_, digest_.c_str(), digest_.length(), 0);
+   // Send the response: the bytes of the digest, or their hex chars, after the tree prefix for tree hashes
+   char response[sizeof(C_S_TREE_PREFIX) - 1 + 2 * lcr::DigestValue::C_S_MAX_SIZE];
+   std::size_t length = 0;
+   if(tree_) {
+      std::memcpy(response, C_S_TREE_PREFIX, sizeof(C_S_TREE_PREFIX) - 1);
+      length = sizeof(C_S_TREE_PREFIX) - 1;
+   }
+   if(raw_) {
+      std::memcpy(response + length, digest_.data(), digest_.size());
+      length += digest_.size();
+   }
+   else {
+      digest_.hex(response + length);
+      length += 2 * digest_.size();
+   }
+   auto sending = std::chrono::steady_clock::now();
+   int bytes_sent = send(sockfd_, response, length, 0);
+   measure_(Phase::send, sending);
    if(bytes_sent==-1) {
       ec_ = true;
       error_ = true;
-      logger_.trace(LOG_WARNING, "[WORKER] ID#%u - Sending error: (%d)", id_, ec_);
+      LCR_TRACE(logger_, LOG_WARNING, "[WORKER] ID#%u - Sending error: (%d)", id_, ec_);
    }
    else {
-      logger_.trace(LOG_LEVEL_5, "[WORKER] ID#%u - Response sent in %d ms: '%s' =digest=> '%s'",
-                    id_, (int)delay_.count(), text_.c_str(), digest_.c_str());
+      LCR_TRACE(logger_, LOG_LEVEL_5, "[WORKER] ID#%u - Response sent in %d ms: '%s' =digest=> '%s'%s%s",
+                    id_, (int)delay_.count(), text_.c_str(), lcr::to_string(digest_).c_str(), raw_? " (raw)" : "", tree_? " (tree)" : "");
    }
 }
 
 
-} // namespace ncs
+// Private method that adds the time since the start to a phase, returns the current time
+std::chrono::steady_clock::time_point Worker::measure_(Phase phase, const std::chrono::steady_clock::time_point& start)
+{
+   auto now = std::chrono::steady_clock::now();
+   latencies_[static_cast<unsigned int>(phase)] += now - start;
+   measured_ |= 1u << static_cast<unsigned int>(phase);
+   return now;
+}
+
 
+} // namespace ncs
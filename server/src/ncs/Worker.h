@@ -11,6 +11,8 @@
 // Stl
 #include <atomic>
 #include <chrono>
+#include <string>
+#include <vector>
 
 // sockets
 #include <netinet/in.h>
@@ -18,18 +20,39 @@
 // lib locar
 #include "lcr/Logger.h"
 #include "lcr/Cache.hpp"
+#include "lcr/md5.h"
+#include "lcr/MD5PrefixCache.h"
+#include "lcr/DigestEngine.h"
+#include "lcr/HashBatcher.h"
 
 
 namespace ncs
 {
 
+// The server cache, parametrized as: KEY(text) => VALUE(binary digest).
+// The key is allocator aware, so the entries can be allocated from the memory resource of the cache,
+// while the digest (up to 32 bytes, for any algorithm) is stored inline in the entry.
+typedef lcr::Cache<std::pmr::string, lcr::DigestValue> DigestCache;
+
 // This class represents the NCS worker, which process a received request from one client
 class Worker
 {
    public:
-      // The constructor receives as parameters an unique identifier and a socket decriptor.
+      // The phases of a request whose latencies are measured: from the connection to its first byte, the reception of
+      // the request line, its parsing, the cache lookups, the delay, the hashing, the response and the whole request
+      enum class Phase : unsigned int { accept, receive, parse, lookup, delay, hash, send, total };
+      static constexpr unsigned int C_S_PHASES = 8;
+
+      // Function that returns the name of a phase
+      static const char * phase_name(Phase phase);
+
+   public:
+      // The constructor receives as parameters an unique identifier, a socket decriptor, the root directory of the files
+      // that the clients can hash (empty when disabled), the MD5 prefix cache for the texts and the hashing stage that
+      // batches the texts of all the workers (both null when disabled).
       // It also receives a reference to the logger to show traces of its operation.
-      Worker(unsigned int id, int sockfd, const sockaddr_in& addr, lcr::Cache<std::string, std::string>& cache, lcr::Logger& logger);
+      Worker(unsigned int id, int sockfd, const sockaddr_in& addr, DigestCache& cache, const std::string& root,
+             lcr::MD5PrefixCache* prefixes, lcr::HashBatcher* batcher, lcr::Logger& logger);
       virtual ~Worker();
 
    public:
@@ -53,10 +76,48 @@ class Worker
          return error_;
       }
 
+      // Getter method for the number of bytes hashed
+      unsigned long long hashed() const {
+         return hashed_;
+      }
+
+      // Getter method for the time spent hashing
+      std::chrono::nanoseconds hashing_time() const {
+         return hashing_time_;
+      }
+
+      // Getter method for the number of bytes of streamed bodies
+      unsigned long long streamed() const {
+         return streamed_;
+      }
+
+      // Getter method for the time spent receiving and hashing streamed bodies
+      std::chrono::nanoseconds streaming_time() const {
+         return streaming_time_;
+      }
+
+      // Getter method that returns true if the request went through a phase
+      bool measured(Phase phase) const {
+         return measured_ & (1u << static_cast<unsigned int>(phase));
+      }
+
+      // Getter method for the time spent in a phase
+      std::chrono::nanoseconds latency(Phase phase) const {
+         return latencies_[static_cast<unsigned int>(phase)];
+      }
+
    private:
-      int async_recv_(char* buffer, int timeout);
-      bool process_request_(char* buffer, int bytes_received);
+      int async_recv_(char* buffer, std::size_t size, int timeout);
+      bool process_request_(char* buffer, std::size_t length, std::size_t bytes_received);
+      bool parse_options_(std::vector<std::string>& tokens);
+      bool process_hash_(const std::vector<std::string>& tokens, const char* body, std::size_t bytes);
+      bool hash_body_(unsigned long long length, const char* body, std::size_t bytes);
+      bool process_file_(const std::vector<std::string>& tokens);
+      bool hash_file_(int fd, std::size_t size);
+      bool read_file_(int fd, char* data, std::size_t size, std::size_t offset);
+      bool wait_delay_(const std::chrono::time_point<std::chrono::system_clock>& start);
       void send_response_();
+      std::chrono::steady_clock::time_point measure_(Phase phase, const std::chrono::steady_clock::time_point& start);
 
    private:
       // The logger reference
@@ -77,15 +138,41 @@ class Worker
       // The request reception timeout
       unsigned int timeout_;
 
+      // The reception buffer: it holds the request line and then every chunk of a streamed body
+      std::vector<char> buffer_;
+
       // The cache reference
-      lcr::Cache<std::string, std::string>& cache_;
+      DigestCache& cache_;
+
+      // The root directory of the files that can be hashed: a canonical path, or empty when files are disabled
+      const std::string& root_;
+
+      // The cache of MD5 states after common text prefixes, or null when disabled
+      lcr::MD5PrefixCache* prefixes_;
+
+      // The hashing stage that batches the texts of all the workers, or null when disabled
+      lcr::HashBatcher* batcher_;
 
       // The worker internal status
-      std::string text_;     // The request text
-      std::string digest_;   // The md5 digest of the previous request text
+      std::pmr::string text_;     // The request text
+      lcr::DigestValue digest_;   // The digest of the previous request text
+      const lcr::DigestEngine* engine_; // The digest algorithm asked by the client (md5 by default)
+      bool raw_;             // Flag that indicates that the client asked for the binary digest instead of the hex one
+      bool tree_;            // Flag that indicates that the client asked for the tree hash of a file instead of its MD5
       bool error_;           // Flag that indicates that an error have ocurred
       int ec_;               // When error_, this may contains the related errno code (or zero)
 
+      // Counters for statistics purposes
+      unsigned long long hashed_;             // Bytes hashed
+      unsigned long long streamed_;           // Bytes hashed from streamed bodies
+      std::chrono::nanoseconds hashing_time_;   // Time spent in the MD5 code
+      std::chrono::nanoseconds streaming_time_; // Time spent receiving and hashing streamed bodies
+
+      // Latencies of the request phases, measured by the worker thread alone and collected by the server when it finishes
+      std::chrono::steady_clock::time_point accepted_; // When the connection was accepted
+      std::chrono::nanoseconds latencies_[C_S_PHASES]; // Time spent in each phase
+      unsigned int measured_;                          // Bit mask of the phases the request went through
+
       // Mutable and atomic flag for the external cancel resquest
       mutable std::atomic<bool> cancelled_;
 };
@@ -0,0 +1,196 @@
+// Stl
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <iostream>
+#include <memory_resource>
+
+// lib locar
+#include "lcr/Cache.hpp"
+#include "lcr/StdLogger.h"
+#include "lcr/DigestEngine.h"
+#include "lcr/CommandLine.hpp"
+
+
+
+// Definitions /////////////////////////////////////////////////////////////////////
+struct Arguments // The Arguments type stores the parameters from the command line after parsing
+{
+   int threads{};          // The number of threads that use the cache
+   int keys{};             // The number of keys in the cache
+   int batch{};            // The number of keys of every batch
+   int lookups{};          // The number of keys looked up by every thread
+};
+
+// The cache of the server: texts to digests
+typedef lcr::Cache<std::pmr::string, lcr::DigestValue> DigestCache;
+
+
+// Prototypes //////////////////////////////////////////////////////////////////////
+void show_usage(); // Function that shows the program usage
+void check(Arguments& args); // Function that checks the arguments validity
+double measure(int threads, const std::function<void(int)>& work); // Function that runs a work in every thread and returns its time in seconds
+
+
+// Static constants ////////////////////////////////////////////////////////////////
+static const int C_S_DEFAULT_THREADS{1};
+static const int C_S_DEFAULT_KEYS{1000000};
+static const int C_S_DEFAULT_BATCH{16};
+static const int C_S_DEFAULT_LOOKUPS{2000000};
+
+
+
+int main(int argc, const char* argv[])
+{
+   // Look for the sow_help parameter
+   if(argc==2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")) {
+      show_usage();
+      return 0;
+   } // else ...
+
+   // Specify the input parameters and proceed to parse the command line
+   auto args = lcr::CommandLine<Arguments>::Parser({
+      {"-t", &Arguments::threads},
+      {"-n", &Arguments::keys},
+      {"-b", &Arguments::batch},
+      {"-l", &Arguments::lookups}
+   })->parse(argc, argv);
+
+   // Check the arguments validity
+   check(args);
+
+   // The keys look like the texts of the requests, and every thread inserts its own slice of them
+   std::vector<std::pmr::string> keys;
+   std::vector<lcr::DigestValue> digests;
+   keys.reserve(args.keys);
+   digests.reserve(args.keys);
+   for(int ii=0; ii<args.keys; ++ii) {
+      keys.emplace_back("text-to-hash-" + std::to_string(ii * 2654435761u));
+      digests.push_back(lcr::DigestEngine::md5().digest(keys.back().data(), keys.back().size()));
+   }
+   lcr::Logger& logger = lcr::StdLogger::instance(1);
+   auto slice = [&args](int thread) {
+      return std::make_pair(std::size_t(args.keys) * thread / args.threads, std::size_t(args.keys) * (thread + 1) / args.threads);
+   };
+
+   DigestCache single(args.keys, 0, logger);
+   double set = measure(args.threads, [&](int thread) {
+      for(std::size_t ii=slice(thread).first; ii<slice(thread).second; ++ii) {
+         single.set(keys[ii], digests[ii]);
+      }
+   });
+   DigestCache batched(args.keys, 0, logger);
+   double setMany = measure(args.threads, [&](int thread) {
+      std::vector<std::pmr::string> batch_keys;
+      std::vector<lcr::DigestValue> batch_digests;
+      for(std::size_t ii=slice(thread).first; ii<slice(thread).second; ) {
+         batch_keys.clear();
+         batch_digests.clear();
+         for(int jj=0; jj<args.batch && ii<slice(thread).second; ++jj, ++ii) {
+            batch_keys.push_back(keys[ii]);
+            batch_digests.push_back(digests[ii]);
+         }
+         batched.setMany(batch_keys, batch_digests);
+      }
+   });
+
+   // The lookups take random keys, so the near cache rarely has them and the map is searched
+   unsigned long long found = 0, found_many = 0;
+   std::vector<unsigned long long> counts(args.threads);
+   double get = measure(args.threads, [&](int thread) {
+      std::mt19937 random(thread);
+      lcr::DigestValue digest;
+      for(int ii=0; ii<args.lookups; ++ii) {
+         counts[thread] += single.get(keys[random() % keys.size()], digest);
+      }
+   });
+   for(auto count : counts) {
+      found += count;
+   }
+   counts.assign(args.threads, 0);
+   double getMany = measure(args.threads, [&](int thread) {
+      std::mt19937 random(thread);
+      std::vector<std::pmr::string> batch_keys(args.batch);
+      std::vector<lcr::DigestValue> batch_digests;
+      std::vector<bool> batch_found;
+      for(int ii=0; ii<args.lookups; ii+=args.batch) {
+         for(auto& key : batch_keys) {
+            key = keys[random() % keys.size()];
+         }
+         counts[thread] += batched.getMany(batch_keys, batch_digests, batch_found);
+      }
+   });
+   for(auto count : counts) {
+      found_many += count;
+   }
+
+   double sets = double(args.keys), lookups = double(args.threads) * args.lookups;
+   fprintf(stderr, "%d threads, %d keys, batches of %d:\n", args.threads, args.keys, args.batch);
+   fprintf(stderr, "   set:     %8.1f ns per key   setMany: %8.1f ns per key (%.2fx)\n",
+           set * 1e9 / sets * args.threads, setMany * 1e9 / sets * args.threads, set / setMany);
+   fprintf(stderr, "   get:     %8.1f ns per key   getMany: %8.1f ns per key (%.2fx), %llu and %llu found\n",
+           get * 1e9 / lookups * args.threads, getMany * 1e9 / lookups * args.threads, get / getMany, found, found_many);
+   return 0;
+}
+
+
+
+// Function that runs a work in every thread, the index of the thread as parameter, and returns its time in seconds
+double measure(int threads, const std::function<void(int)>& work)
+{
+   auto start = std::chrono::steady_clock::now();
+   std::vector<std::thread> workers;
+   for(int ii=0; ii<threads; ++ii) {
+      workers.emplace_back(work, ii);
+   }
+   for(auto& worker : workers) {
+      worker.join();
+   }
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+// Function that shows the program usage
+void show_usage()
+{
+   std::cout << "---- Command line -----------------------------------------------------------------------------------------------------" << std::endl << std::endl;
+   std::cout << " -h      Program help" << std::endl;
+   std::cout << " --help  Show details of the program usage" << std::endl << std::endl;
+   std::cout << " -t      Threads" << std::endl;
+   std::cout << "         The number of threads that use the cache." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_THREADS << std::endl << std::endl;
+   std::cout << " -n      Keys" << std::endl;
+   std::cout << "         The number of keys set in the cache, which is also its capacity." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_KEYS << std::endl << std::endl;
+   std::cout << " -b      Batch" << std::endl;
+   std::cout << "         The number of keys of every call to setMany and getMany." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_BATCH << std::endl << std::endl;
+   std::cout << " -l      Lookups" << std::endl;
+   std::cout << "         The number of random keys looked up by every thread, one by one and then in batches." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_LOOKUPS << std::endl << std::endl;
+   std::cout << " Compares the time per key of set and get with the batched setMany and getMany, e.g.:" << std::endl;
+   std::cout << "    cachebench -t 4 -b 32" << std::endl << std::endl;
+}
+
+
+// Function that checks the arguments validity
+void check(Arguments& args)
+{
+   if(args.threads<=0) {
+      args.threads = C_S_DEFAULT_THREADS;
+   }
+   if(args.keys<=0) {
+      args.keys = C_S_DEFAULT_KEYS;
+   }
+   if(args.batch<=0) {
+      args.batch = C_S_DEFAULT_BATCH;
+   }
+   if(args.lookups<=0) {
+      args.lookups = C_S_DEFAULT_LOOKUPS;
+   }
+}
@@ -0,0 +1,309 @@
+// Stl
+#include <string>
+#include <vector>
+#include <tuple>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <string_view>
+
+// lib locar
+#include "lcr/md5.h"
+#include "lcr/sha.h"
+#include "lcr/CommandLine.hpp"
+
+
+
+// Definitions /////////////////////////////////////////////////////////////////////
+struct Arguments // The Arguments type stores the parameters from the command line after parsing
+{
+   int batches{};          // The number of random batches (and SHA texts) hashed by every kernel
+};
+
+// The digests of a text with the SHA algorithms
+struct SHADigests
+{
+   lcr::SHA1Digest sha1;
+   lcr::SHA256Digest sha256;
+};
+
+
+// Prototypes //////////////////////////////////////////////////////////////////////
+void show_usage(); // Function that shows the program usage
+bool check_md5_vectors(); // Function that checks the scalar MD5 against the RFC 1321 test suite
+bool check_md5_binding(); // Function that checks the kernel bound at start up
+bool check_md5_kernels(int batches); // Function that checks every supported batch kernel against the scalar MD5
+bool check_sha_binding(); // Function that checks the SHA kernel bound at start up
+bool check_sha_kernels(int batches); // Function that checks every supported SHA kernel, one-shot and streamed
+SHADigests sha_stream(const std::string& text, std::mt19937& random); // Function that returns the digests of a text given in random pieces
+
+
+// Static constants ////////////////////////////////////////////////////////////////
+static const int C_S_DEFAULT_BATCHES{2000};
+static const std::size_t C_S_MAX_LENGTH{300};
+static const lcr::MD5Kernel C_S_MD5_KERNELS[] = { lcr::MD5Kernel::scalar, lcr::MD5Kernel::sse2, lcr::MD5Kernel::avx2, lcr::MD5Kernel::avx512 };
+static const lcr::SHAKernel C_S_SHA_KERNELS[] = { lcr::SHAKernel::scalar, lcr::SHAKernel::shani };
+
+
+
+int main(int argc, const char* argv[])
+{
+   // Look for the sow_help parameter
+   if(argc==2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")) {
+      show_usage();
+      return 0;
+   } // else ...
+
+   // Specify the input parameters and proceed to parse the command line
+   auto args = lcr::CommandLine<Arguments>::Parser({
+      {"-n", &Arguments::batches}
+   })->parse(argc, argv);
+   if(args.batches<=0) {
+      args.batches = C_S_DEFAULT_BATCHES;
+   }
+
+   bool passed = true;
+   passed = check_md5_binding() && passed; // First: the binding is done on first use
+   passed = check_sha_binding() && passed;
+   passed = check_md5_vectors() && passed;
+   passed = check_md5_kernels(args.batches) && passed;
+   passed = check_sha_kernels(args.batches) && passed;
+   fprintf(stderr, "%s\n", passed ? "All the checks passed" : "Some checks FAILED");
+   return passed ? 0 : 1;
+}
+
+
+
+// Function that returns the hex representation of a digest
+template <class DIGEST>
+std::string hex(const DIGEST& digest)
+{
+   static const char digits[] = "0123456789abcdef";
+   std::string text;
+   for(auto byte : digest) {
+      text += digits[byte >> 4];
+      text += digits[byte & 0x0f];
+   }
+   return text;
+}
+
+
+// Function that checks the scalar MD5, the reference of the kernels, against the RFC 1321 test suite
+bool check_md5_vectors()
+{
+   static const char * const C_S_VECTORS[][2] = {
+      { "", "d41d8cd98f00b204e9800998ecf8427e" },
+      { "a", "0cc175b9c0f1b6a831c399e269772661" },
+      { "abc", "900150983cd24fb0d6963f7d28e17f72" },
+      { "message digest", "f96b697d7cb7938d525a2f31aaf161d0" },
+      { "abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b" },
+      { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", "d174ab98d277d9f5a5611c2c9f419d9f" },
+      { "12345678901234567890123456789012345678901234567890123456789012345678901234567890", "57edf4a22be3c955ac49da2e2107b67a" }
+   };
+   bool passed = true;
+   for(const auto& vector : C_S_VECTORS) {
+      std::string digest = hex(lcr::md5_digest(vector[0], std::char_traits<char>::length(vector[0])));
+      if(digest!=vector[1]) {
+         fprintf(stderr, "  MD5('%s'): %s, expected %s\n", vector[0], digest.c_str(), vector[1]);
+         passed = false;
+      }
+   }
+   fprintf(stderr, "[%s] MD5 test suite of RFC 1321\n", passed ? "PASS" : "FAIL");
+   return passed;
+}
+
+
+// Function that checks the kernel bound at start up: the one named by LCR_MD5_KERNEL if the CPU supports it, the widest
+// supported one otherwise. It must run before any kernel is selected
+bool check_md5_binding()
+{
+   lcr::MD5Kernel bound = lcr::md5_kernel();
+   lcr::MD5Kernel expected = lcr::MD5Kernel::scalar;
+   for(auto kernel : C_S_MD5_KERNELS) { // Widest last
+      if(lcr::md5_select(kernel)) {
+         expected = kernel;
+      }
+   }
+   const char * name = std::getenv("LCR_MD5_KERNEL");
+   lcr::MD5Kernel requested;
+   if(name && lcr::md5_kernel_from_name(name, requested) && lcr::md5_select(requested)) {
+      expected = requested;
+   }
+   lcr::md5_select(bound);
+   bool passed = (bound==expected);
+   fprintf(stderr, "[%s] MD5 binding: %s bound, %s expected (LCR_MD5_KERNEL=%s)\n", passed ? "PASS" : "FAIL", lcr::md5_kernel_name(bound),
+           lcr::md5_kernel_name(expected), name ? name : "");
+   return passed;
+}
+
+
+// Function that checks every batch kernel supported by the CPU against the scalar MD5: batches of every size up to
+// twice the widest lanes, so there are partial batches, of random texts from 0 to 300 bytes, which cross the block
+// boundaries of the padding at different lanes
+bool check_md5_kernels(int batches)
+{
+   bool passed = true;
+   lcr::MD5Kernel bound = lcr::md5_kernel();
+   for(auto kernel : C_S_MD5_KERNELS) {
+      if(!lcr::md5_select(kernel)) {
+         fprintf(stderr, "[SKIP] MD5 %s kernel: not supported by the CPU\n", lcr::md5_kernel_name(kernel));
+         continue;
+      }
+      std::mt19937 random(static_cast<unsigned int>(kernel));
+      std::size_t errors = 0, texts = 0;
+      for(int ii=0; ii<batches; ++ii) {
+         std::size_t count = 1 + ii % 32;
+         std::vector<std::string> data(count);
+         std::vector<std::string_view> views(count);
+         for(std::size_t jj=0; jj<count; ++jj) {
+            data[jj].resize(random() % (C_S_MAX_LENGTH + 1));
+            for(auto& c : data[jj]) {
+               c = static_cast<char>(random());
+            }
+            views[jj] = data[jj];
+         }
+         std::vector<lcr::MD5::Digest> digests(count);
+         lcr::md5_many(views.data(), digests.data(), count);
+         for(std::size_t jj=0; jj<count; ++jj, ++texts) {
+            if(digests[jj]!=lcr::md5_digest(data[jj].data(), data[jj].size())) {
+               if(!errors++) {
+                  fprintf(stderr, "  MD5 %s kernel: text %zu of a batch of %zu (%zu bytes) has a wrong digest\n", lcr::md5_kernel_name(kernel),
+                          jj, count, data[jj].size());
+               }
+            }
+         }
+      }
+      fprintf(stderr, "[%s] MD5 %s kernel: %zu texts in batches of 1 to 32, %zu wrong\n", errors ? "FAIL" : "PASS", lcr::md5_kernel_name(kernel),
+              texts, errors);
+      passed = passed && !errors;
+   }
+   lcr::md5_select(bound);
+   return passed;
+}
+
+
+// Function that checks the SHA kernel bound at start up: the one named by LCR_SHA_KERNEL if the CPU supports it, the
+// SHA extensions if the CPU has them, the portable code otherwise. It must run before any kernel is selected
+bool check_sha_binding()
+{
+   lcr::SHAKernel bound = lcr::sha_kernel();
+   lcr::SHAKernel expected = lcr::SHAKernel::scalar;
+   for(auto kernel : C_S_SHA_KERNELS) { // Best last
+      if(lcr::sha_select(kernel)) {
+         expected = kernel;
+      }
+   }
+   const char * name = std::getenv("LCR_SHA_KERNEL");
+   lcr::SHAKernel requested;
+   if(name && lcr::sha_kernel_from_name(name, requested) && lcr::sha_select(requested)) {
+      expected = requested;
+   }
+   lcr::sha_select(bound);
+   bool passed = (bound==expected);
+   fprintf(stderr, "[%s] SHA binding: %s bound, %s expected (LCR_SHA_KERNEL=%s)\n", passed ? "PASS" : "FAIL", lcr::sha_kernel_name(bound),
+           lcr::sha_kernel_name(expected), name ? name : "");
+   return passed;
+}
+
+
+// Function that checks every SHA kernel supported by the CPU: the FIPS 180 test vectors, of one and many blocks, then
+// random texts from 0 to 300 bytes against the portable code. Every text is hashed in one shot and given to the stream in
+// random pieces, which cross the block boundaries
+bool check_sha_kernels(int batches)
+{
+   static const char * const C_S_VECTORS[][3] = {
+      { "", "da39a3ee5e6b4b0d3255bfef95601890afd80709", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+      { "abc", "a9993e364706816aba3e25717850c26c9cd0d89d", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+      { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+      { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+        "a49b2446a02c645bf419f995b67091253a04a259", "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+      { nullptr, "34aa973cd4c4daa4f61eeb2bdbad27316534016f", "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" } // A million 'a'
+   };
+   const std::string million(1000000, 'a');
+
+   // The references of the random texts are given by the portable code
+   lcr::SHAKernel bound = lcr::sha_kernel();
+   std::mt19937 random(batches);
+   std::vector<std::string> texts(batches);
+   std::vector<SHADigests> references(batches);
+   lcr::sha_select(lcr::SHAKernel::scalar);
+   for(int ii=0; ii<batches; ++ii) {
+      texts[ii].resize(random() % (C_S_MAX_LENGTH + 1));
+      for(auto& c : texts[ii]) {
+         c = static_cast<char>(random());
+      }
+      references[ii] = { lcr::sha1_digest(texts[ii].data(), texts[ii].size()), lcr::sha256_digest(texts[ii].data(), texts[ii].size()) };
+   }
+
+   bool passed = true;
+   for(auto kernel : C_S_SHA_KERNELS) {
+      if(!lcr::sha_select(kernel)) {
+         fprintf(stderr, "[SKIP] SHA %s kernel: not supported by the CPU\n", lcr::sha_kernel_name(kernel));
+         continue;
+      }
+      std::size_t errors = 0;
+      for(const auto& vector : C_S_VECTORS) {
+         std::string text = vector[0] ? std::string(vector[0]) : million;
+         SHADigests streamed = sha_stream(text, random);
+         std::string sha1 = hex(lcr::sha1_digest(text.data(), text.size())), sha256 = hex(lcr::sha256_digest(text.data(), text.size()));
+         for(const auto& [digest, expected, algorithm] : { std::make_tuple(sha1, vector[1], "SHA-1"), std::make_tuple(hex(streamed.sha1), vector[1], "SHA-1 stream"),
+                                                         std::make_tuple(sha256, vector[2], "SHA-256"), std::make_tuple(hex(streamed.sha256), vector[2], "SHA-256 stream") }) {
+            if(digest!=expected) {
+               fprintf(stderr, "  %s %s kernel ('%.20s', %zu bytes): %s, expected %s\n", algorithm, lcr::sha_kernel_name(kernel), text.c_str(),
+                       text.size(), digest.c_str(), expected);
+               ++errors;
+            }
+         }
+      }
+      std::size_t wrong = 0;
+      for(int ii=0; ii<batches; ++ii) {
+         SHADigests streamed = sha_stream(texts[ii], random);
+         if(lcr::sha1_digest(texts[ii].data(), texts[ii].size())!=references[ii].sha1 || streamed.sha1!=references[ii].sha1 ||
+            lcr::sha256_digest(texts[ii].data(), texts[ii].size())!=references[ii].sha256 || streamed.sha256!=references[ii].sha256) {
+            if(!wrong++) {
+               fprintf(stderr, "  SHA %s kernel: text %d (%zu bytes) has a wrong digest\n", lcr::sha_kernel_name(kernel), ii, texts[ii].size());
+            }
+         }
+      }
+      fprintf(stderr, "[%s] SHA %s kernel: FIPS 180 vectors %zu wrong, %d random texts %zu wrong, one-shot and streamed\n",
+              errors || wrong ? "FAIL" : "PASS", lcr::sha_kernel_name(kernel), errors, batches, wrong);
+      passed = passed && !errors && !wrong;
+   }
+   lcr::sha_select(bound);
+   return passed;
+}
+
+
+// Function that returns the SHA-1 and SHA-256 digests of a text given to the streams in random pieces, empty ones included
+SHADigests sha_stream(const std::string& text, std::mt19937& random)
+{
+   lcr::SHAStream sha1(lcr::SHAStream::Algorithm::sha1), sha256(lcr::SHAStream::Algorithm::sha256);
+   for(std::size_t offset=0, length; offset<text.size(); offset+=length) {
+      length = std::min<std::size_t>(random() % 150, text.size() - offset);
+      sha1.update(text.data() + offset, length);
+      sha256.update(text.data() + offset, length);
+   }
+   SHADigests digests;
+   sha1.finalize(digests.sha1.data());
+   sha256.finalize(digests.sha256.data());
+   return digests;
+}
+
+
+
+// Function that shows the program usage
+void show_usage()
+{
+   std::cout << "---- Command line -----------------------------------------------------------------------------------------------------" << std::endl << std::endl;
+   std::cout << " -h      Program help" << std::endl;
+   std::cout << " --help  Show details of the program usage" << std::endl << std::endl;
+   std::cout << " -n      Batches" << std::endl;
+   std::cout << "         The number of random batches hashed by every kernel." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_BATCHES << std::endl << std::endl;
+   std::cout << " Checks the digests of every kernel supported by the CPU against the portable code and the standard test vectors." << std::endl;
+   std::cout << " The kernels bound at start up can be chosen with LCR_MD5_KERNEL and LCR_SHA_KERNEL. The results are written to the" << std::endl;
+   std::cout << " standard error, and the exit code is not zero on failure." << std::endl << std::endl;
+}
@@ -0,0 +1,180 @@
+// Stl
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <iostream>
+
+// lib locar
+#include "lcr/StdLogger.h"
+#include "lcr/AsyncLogger.h"
+#include "lcr/FileLogger.h"
+#include "lcr/BinaryLogger.h"
+#include "lcr/CommandLine.hpp"
+
+
+
+// Definitions /////////////////////////////////////////////////////////////////////
+struct Arguments // The Arguments type stores the parameters from the command line after parsing
+{
+   int threads{};          // The number of threads that write traces
+   int lines{};            // The number of traces written by every thread
+   int level{};            // The logger level
+   int rotate_size{};      // The rotation size of the file logger, in MB
+   std::string logger{};   // The logger type
+   std::string file{};     // The file of the file and binary loggers
+};
+
+
+// Prototypes //////////////////////////////////////////////////////////////////////
+void show_usage(); // Function that shows the program usage
+void check(Arguments& args); // Function that checks the arguments validity
+
+
+// Static constants ////////////////////////////////////////////////////////////////
+static const int C_S_DEFAULT_THREADS{1};
+static const int C_S_DEFAULT_LINES{200000};
+static const int C_S_DEFAULT_LEVEL{5};
+static const std::string C_S_DEFAULT_LOGGER{"std"};
+static const std::string C_S_DEFAULT_FILE{"logbench.log"};
+
+
+
+int main(int argc, const char* argv[])
+{
+   // Look for the sow_help parameter
+   if(argc==2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")) {
+      show_usage();
+      return 0;
+   } // else ...
+
+   // Specify the input parameters and proceed to parse the command line
+   auto args = lcr::CommandLine<Arguments>::Parser({
+      {"-t", &Arguments::threads},
+      {"-n", &Arguments::lines},
+      {"-l", &Arguments::level},
+      {"-L", &Arguments::logger},
+      {"-o", &Arguments::file},
+      {"-S", &Arguments::rotate_size}
+   })->parse(argc, argv);
+
+   // Check the arguments validity
+   check(args);
+
+   // The traces go to the standard output: redirect it (e.g. to /dev/null) to measure the logger and not the terminal
+   std::unique_ptr<lcr::AsyncLogger> async;
+   std::unique_ptr<lcr::BinaryLogger> binary;
+   lcr::Logger * logger = nullptr;
+   if(args.logger=="std") {
+      logger = &lcr::StdLogger::instance(args.level);
+   }
+   else if(args.logger=="binary") {
+      binary.reset(new lcr::BinaryLogger(args.file, args.level));
+      logger = binary.get();
+   }
+   else if(args.logger=="file" || args.logger=="file-block") {
+      async.reset(new lcr::FileLogger(args.file, args.level, args.rotate_size * std::size_t(1024 * 1024), std::chrono::seconds(0),
+                                      lcr::FileLogger::C_S_DEFAULT_FILES, lcr::AsyncLogger::C_S_DEFAULT_CAPACITY,
+                                      (args.logger=="file-block"? lcr::AsyncLogger::Overflow::block : lcr::AsyncLogger::Overflow::drop)));
+      logger = async.get();
+   }
+   else {
+      async.reset(new lcr::AsyncLogger(args.level, lcr::AsyncLogger::C_S_DEFAULT_CAPACITY,
+                                       (args.logger=="async-block"? lcr::AsyncLogger::Overflow::block : lcr::AsyncLogger::Overflow::drop)));
+      logger = async.get();
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   std::vector<std::thread> threads;
+   for(int ii=0; ii<args.threads; ++ii) {
+      threads.emplace_back([&args, logger, ii]() {
+         for(int jj=0; jj<args.lines; ++jj) {
+            LCR_TRACE((*logger), LOG_LEVEL_5, "[WORKER] ID#%d - Message proccesed in %d ms", jj, ii);
+         }
+      });
+   }
+   for(auto& thread : threads) {
+      thread.join();
+   }
+   double traced = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   if(async) {
+      async->flush();
+   }
+   double written = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   // The asynchronous logger may drop records, so it counts the lines actually written
+   double lines = double(args.threads) * args.lines;
+   double lines_written = (async? double(async->written()) : (binary? double(binary->written()) : lines));
+   fprintf(stderr, "%s logger, %d threads, %.0f lines: %.0f lines/s traced (%.3f us per trace), %.0f lines/s written",
+           args.logger.c_str(), args.threads, lines, lines / traced, traced * 1e6 / lines * args.threads, lines_written / written);
+   if(async) {
+      fprintf(stderr, ", %llu dropped", async->dropped());
+   }
+   if(binary) {
+      fprintf(stderr, ", %llu dropped", binary->dropped());
+   }
+   fprintf(stderr, "\n");
+   return 0;
+}
+
+
+
+// Function that shows the program usage
+void show_usage()
+{
+   std::cout << "---- Command line -----------------------------------------------------------------------------------------------------" << std::endl << std::endl;
+   std::cout << " -h      Program help" << std::endl;
+   std::cout << " --help  Show details of the program usage" << std::endl << std::endl;
+   std::cout << " -t      Threads" << std::endl;
+   std::cout << "         The number of threads that write traces." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_THREADS << std::endl << std::endl;
+   std::cout << " -n      Lines" << std::endl;
+   std::cout << "         The number of traces written by every thread." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_LINES << std::endl << std::endl;
+   std::cout << " -l      Logger level" << std::endl;
+   std::cout << "         The traces are written at level 5: a lower level measures the cost of the disabled traces." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_LEVEL << std::endl << std::endl;
+   std::cout << " -L      Logger type" << std::endl;
+   std::cout << "         Posible values: std, async, async-block, file, file-block, binary" << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_LOGGER << std::endl << std::endl;
+   std::cout << " -o      Log file" << std::endl;
+   std::cout << "         The file written by the file and binary loggers." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_FILE << std::endl << std::endl;
+   std::cout << " -S      Rotation size" << std::endl;
+   std::cout << "         The size in MB that starts a new file in the file logger. When zero, the file is not rotated." << std::endl;
+   std::cout << "         Default value: 0" << std::endl << std::endl;
+   std::cout << " The traces are written to the standard output and the results to the standard error, e.g.:" << std::endl;
+   std::cout << "    logbench -t 4 -L async > /dev/null" << std::endl << std::endl;
+}
+
+
+// Function that checks the arguments validity
+void check(Arguments& args)
+{
+   if(args.threads<=0) {
+      args.threads = C_S_DEFAULT_THREADS;
+   }
+   if(args.lines<=0) {
+      args.lines = C_S_DEFAULT_LINES;
+   }
+   if(args.level<=0) {
+      args.level = C_S_DEFAULT_LEVEL;
+   }
+   if(args.logger.empty()) {
+      args.logger = C_S_DEFAULT_LOGGER;
+   }
+   if(args.file.empty()) {
+      args.file = C_S_DEFAULT_FILE;
+   }
+   if(args.rotate_size<0) {
+      args.rotate_size = 0;
+   }
+   if(args.logger!="std" && args.logger!="async" && args.logger!="async-block" && args.logger!="file" && args.logger!="file-block" &&
+      args.logger!="binary") {
+      std::cerr << "Invalid logger type: " << args.logger << std::endl;
+      show_usage();
+      exit(-1);
+   }
+}
@@ -0,0 +1,230 @@
+// Stl
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+
+// lib locar
+#include "lcr/BinaryLogger.h"
+#include "lcr/CommandLine.hpp"
+
+
+
+// Definitions /////////////////////////////////////////////////////////////////////
+struct Arguments // The Arguments type stores the parameters from the command line after parsing
+{
+   std::string file{};     // The file written by the binary logger
+};
+
+
+// Prototypes //////////////////////////////////////////////////////////////////////
+void show_usage(); // Function that shows the program usage
+bool check_formats(const std::string& path); // Function that checks the decoding of every kind of conversion
+bool check_truncated(const std::string& path); // Function that checks the decoding of a file cut in a record
+bool check_corrupted(const std::string& path); // Function that checks the decoding of a record with a corrupted string length
+bool check_full(const std::string& path); // Function that checks the decoding of a file that ran out of room
+std::vector<std::string> decode(lcr::BinaryLogReader& reader); // Function that decodes the messages of a file
+std::string read(const std::string& path); // Function that returns the contents of a file
+void write(const std::string& path, const std::string& data); // Function that replaces the contents of a file
+
+
+// Static constants ////////////////////////////////////////////////////////////////
+static const std::string C_S_DEFAULT_FILE{"logcheck.blog"};
+static const unsigned int C_S_LEVEL{5};
+
+
+
+int main(int argc, const char* argv[])
+{
+   // Look for the sow_help parameter
+   if(argc==2 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")) {
+      show_usage();
+      return 0;
+   } // else ...
+
+   // Specify the input parameters and proceed to parse the command line
+   auto args = lcr::CommandLine<Arguments>::Parser({
+      {"-o", &Arguments::file}
+   })->parse(argc, argv);
+   if(args.file.empty()) {
+      args.file = C_S_DEFAULT_FILE;
+   }
+
+   bool passed = true;
+   passed = check_formats(args.file) && passed;
+   passed = check_truncated(args.file) && passed;
+   passed = check_corrupted(args.file) && passed;
+   passed = check_full(args.file) && passed;
+   std::remove(args.file.c_str());
+   fprintf(stderr, "%s\n", passed ? "All the checks passed" : "Some checks FAILED");
+   return passed ? 0 : 1;
+}
+
+
+
+// The traces are written with the binary logger and with snprintf: the decoder must give the same text
+#define TRACE_AND_EXPECT(logger, expected, ...) \
+   do { \
+      char text[lcr::BinaryLogger::C_S_RECORD_SIZE]; \
+      snprintf(text, sizeof(text), __VA_ARGS__); \
+      expected.push_back(text); \
+      logger.trace(C_S_LEVEL, __FILE__, __LINE__, __VA_ARGS__); \
+   } while(0)
+
+
+// Function that checks the decoding of every kind of conversion: length modifiers, flags, width and precision given
+// as arguments, strings not null terminated, pointers and long doubles
+bool check_formats(const std::string& path)
+{
+   std::vector<std::string> expected;
+   {
+      lcr::BinaryLogger logger(path, C_S_LEVEL);
+      const char unterminated[4] = { 'a', 'b', 'c', 'd' };
+      TRACE_AND_EXPECT(logger, expected, "a %d b %u c %x %X %o %i", -5, 4000000000u, 255u, 255u, 8u, 0);
+      TRACE_AND_EXPECT(logger, expected, "%hhd %hhd %hhu %hd %hu", 300, -200, 300, 70000, 70000);
+      TRACE_AND_EXPECT(logger, expected, "%ld %lu %lld %llu", -7l, 7ul, -1234567890123ll, 18446744073709551615ull);
+      TRACE_AND_EXPECT(logger, expected, "%zu %zd %jd %ju %td", std::size_t(42), static_cast<std::ptrdiff_t>(-3), intmax_t(-7), uintmax_t(7), std::ptrdiff_t(-8));
+      TRACE_AND_EXPECT(logger, expected, "[%*.*s] [%-*.*s] [%.3s] [%*d] [%.*f]", 8, 2, "hello", 8, 3, "hello", unterminated, -6, 7, 3, 3.14159);
+      TRACE_AND_EXPECT(logger, expected, "%5.2f %e %E %g %G %a %c", 2.5, 1e10, -1e-10, 0.0001, 1e20, 0.5, 'Z');
+      TRACE_AND_EXPECT(logger, expected, "%Lf %.2Lf %Le", 1.5L, -2.25L, 3e8L);
+      TRACE_AND_EXPECT(logger, expected, "%p %20p %-20p|", reinterpret_cast<void *>(0x1234), reinterpret_cast<void *>(0xdeadbeef), reinterpret_cast<void *>(0x10));
+      TRACE_AND_EXPECT(logger, expected, "100%% done %s %+d %05d %#x % d", "x", 5, 42, 255u, 3);
+      TRACE_AND_EXPECT(logger, expected, "%s", std::string(lcr::BinaryLogger::C_S_STRING_SIZE - 1, 's').c_str());
+      TRACE_AND_EXPECT(logger, expected, "no arguments");
+   }
+   lcr::BinaryLogReader reader(path);
+   std::vector<std::string> decoded = decode(reader);
+   bool passed = (decoded==expected);
+   for(std::size_t ii=0; ii<std::max(decoded.size(), expected.size()); ++ii) {
+      if(ii>=decoded.size() || ii>=expected.size() || decoded[ii]!=expected[ii]) {
+         fprintf(stderr, "  line %zu:\n    decoded:  '%s'\n    expected: '%s'\n", ii, ii<decoded.size() ? decoded[ii].c_str() : "(none)",
+                 ii<expected.size() ? expected[ii].c_str() : "(none)");
+      }
+   }
+   fprintf(stderr, "[%s] Formats: %zu traces\n", passed ? "PASS" : "FAIL", expected.size());
+   return passed;
+}
+
+
+// Function that checks the decoding of a file cut in the middle of its last record, as a copy taken while the logger
+// writes: the records before it are decoded and the cut one is not
+bool check_truncated(const std::string& path)
+{
+   {
+      lcr::BinaryLogger logger(path, C_S_LEVEL);
+      for(int ii=0; ii<10; ++ii) {
+         logger.trace(C_S_LEVEL, __FILE__, __LINE__, "Record %d of %s", ii, "the truncated file");
+      }
+   }
+   std::string data = read(path);
+   write(path, data.substr(0, data.size() - 5));
+   lcr::BinaryLogReader reader(path);
+   std::vector<std::string> decoded = decode(reader);
+   bool passed = (decoded.size()==9 && decoded.back()=="Record 8 of the truncated file");
+   fprintf(stderr, "[%s] Truncated record: %zu of 10 records decoded\n", passed ? "PASS" : "FAIL", decoded.size());
+   return passed;
+}
+
+
+// Function that checks the decoding of a record whose string length is corrupted with a huge value, so its sum with
+// the offset wraps around: the record is cut at the string, the next one is decoded
+bool check_corrupted(const std::string& path)
+{
+   {
+      lcr::BinaryLogger logger(path, C_S_LEVEL);
+      logger.trace(C_S_LEVEL, __FILE__, __LINE__, "Before %s and %d", "corrupted-string", 7);
+      logger.trace(C_S_LEVEL, __FILE__, __LINE__, "The next record");
+   }
+   std::string data = read(path);
+   std::size_t string = data.find("corrupted-string");
+   if(string==std::string::npos || string<sizeof(std::uint64_t)) {
+      fprintf(stderr, "[FAIL] Corrupted string length: the string is not in the file\n");
+      return false;
+   }
+   const std::uint64_t length = ~std::uint64_t(0) - 7;
+   std::memcpy(&data[string - sizeof(length)], &length, sizeof(length));
+   write(path, data);
+   lcr::BinaryLogReader reader(path);
+   std::vector<std::string> decoded = decode(reader);
+   bool passed = (decoded.size()==2 && decoded[0]=="Before ..." && decoded[1]=="The next record");
+   fprintf(stderr, "[%s] Corrupted string length: '%s'\n", passed ? "PASS" : "FAIL", decoded.empty() ? "" : decoded[0].c_str());
+   return passed;
+}
+
+
+// Function that checks the decoding of a file that ran out of room: the records that fit are decoded and the dropped
+// ones are counted in the header
+bool check_full(const std::string& path)
+{
+   const unsigned long long traces = 10000;
+   unsigned long long written = 0, dropped = 0;
+   {
+      lcr::BinaryLogger logger(path, C_S_LEVEL, 64 * 1024);
+      for(unsigned long long ii=0; ii<traces; ++ii) {
+         logger.trace(C_S_LEVEL, __FILE__, __LINE__, "Record %llu of %s", ii, "the full file");
+      }
+      written = logger.written();
+      dropped = logger.dropped();
+   }
+   lcr::BinaryLogReader reader(path);
+   std::vector<std::string> decoded = decode(reader);
+   bool passed = dropped>0 && written + dropped==traces && decoded.size()==written && reader.dropped()==dropped && !reader.skipped() &&
+                 !decoded.empty() && decoded.back()=="Record " + std::to_string(written - 1) + " of the full file";
+   fprintf(stderr, "[%s] Full file: %zu records decoded, %llu written, %llu dropped (%llu in the file)\n", passed ? "PASS" : "FAIL",
+           decoded.size(), written, dropped, reader.dropped());
+   return passed;
+}
+
+
+
+// Function that decodes the messages of a file: the lines without their timestamp, level and site
+std::vector<std::string> decode(lcr::BinaryLogReader& reader)
+{
+   std::vector<std::string> messages;
+   std::string line;
+   while(reader.next(line)) {
+      std::size_t begin = line.find(": ") + 2;
+      messages.push_back(line.substr(begin, line.rfind("  [") - begin));
+   }
+   if(reader.error()) {
+      fprintf(stderr, "  Unable to decode the file: %s\n", reader.message().c_str());
+   }
+   return messages;
+}
+
+
+// Function that returns the contents of a file
+std::string read(const std::string& path)
+{
+   std::ifstream in(path, std::ios::binary);
+   return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+
+// Function that replaces the contents of a file
+void write(const std::string& path, const std::string& data)
+{
+   std::ofstream out(path, std::ios::binary | std::ios::trunc);
+   out.write(data.data(), data.size());
+}
+
+
+
+// Function that shows the program usage
+void show_usage()
+{
+   std::cout << "---- Command line -----------------------------------------------------------------------------------------------------" << std::endl << std::endl;
+   std::cout << " -h      Program help" << std::endl;
+   std::cout << " --help  Show details of the program usage" << std::endl << std::endl;
+   std::cout << " -o      Log file" << std::endl;
+   std::cout << "         The file written by the binary logger and decoded by the checks. It is removed at the end." << std::endl;
+   std::cout << "         Default value: " << C_S_DEFAULT_FILE << std::endl << std::endl;
+   std::cout << " Writes traces with the binary logger and checks that the decoder gives the text of snprintf, also for truncated," << std::endl;
+   std::cout << " corrupted and full files. The results are written to the standard error, and the exit code is not zero on failure." << std::endl << std::endl;
+}